@@ -589,6 +589,7 @@ typedef struct {
 
   int (*readCommand) (BrailleDisplay *brl);
   int (*writeBraille) (BrailleDisplay *brl, const unsigned char *cells, int start, int count);
+  unsigned char writeOverhead;
 } ProtocolOperations;
 static const ProtocolOperations *protocol;
 
@@ -1161,7 +1162,8 @@ static const ProtocolOperations protocol1Operations = {
   .detectModel = detectModel1,
 
   .readCommand = readCommand1,
-  .writeBraille = writeBraille1
+  .writeBraille = writeBraille1,
+  .writeOverhead = 6
 };
 
 static void
@@ -1646,7 +1648,8 @@ static const ProtocolOperations protocol2sOperations = {
   .detectModel = detectModel2s,
 
   .readCommand = readCommand2s,
-  .writeBraille = writeBraille2s
+  .writeBraille = writeBraille2s,
+  .writeOverhead = 4
 };
 
 static BraillePacketVerifierResult
@@ -1839,7 +1842,8 @@ static const ProtocolOperations protocol2uOperations = {
   .detectModel = detectModel2u,
 
   .readCommand = readCommand2u,
-  .writeBraille = writeBraille2u
+  .writeBraille = writeBraille2u,
+  .writeOverhead = 3
 };
 
 static BrailleDisplay *brailleDisplay = NULL;
@@ -1993,19 +1997,21 @@ brl_destruct (BrailleDisplay *brl) {
 
 static int
 brl_writeWindow (BrailleDisplay *brl, const wchar_t *text) {
-  unsigned int from;
-  unsigned int to;
-
-  if (cellsHaveChanged(previousText, brl->buffer, brl->textColumns, &from, &to, &textRewriteRequired)) {
-    if (model->flags & MOD_FLAG_FORCE_FROM_0) from = 0;
+  int forceFrom0 = !!(model->flags & MOD_FLAG_FORCE_FROM_0);
+  BrailleCellRange ranges[BRL_CELL_RANGE_LIMIT];
+  unsigned int rangeCount = cellRangesHaveChanged(
+    previousText, brl->buffer, brl->textColumns,
+    ranges, (forceFrom0? 1: ARRAY_COUNT(ranges)),
+    protocol->writeOverhead, &textRewriteRequired
+  );
 
-    {
-      size_t count = to - from;
-      unsigned char cells[count];
+  for (unsigned int index=0; index<rangeCount; index+=1) {
+    unsigned int from = forceFrom0? 0: ranges[index].from;
+    size_t count = ranges[index].to - from;
+    unsigned char cells[count];
 
-      translateOutputCells(cells, &brl->buffer[from], count);
-      if (!protocol->writeBraille(brl, cells, textOffset+from, count)) return 0;
-    }
+    translateOutputCells(cells, &brl->buffer[from], count);
+    if (!protocol->writeBraille(brl, cells, textOffset+from, count)) return 0;
   }
 
   return 1;
@@ -229,69 +229,29 @@ struct BrailleDataStruct {
   unsigned char previousCells[MAXIMUM_CELL_COUNT];
 };
 
-static BraillePacketVerifierResult
-verifyPacket (
-  BrailleDisplay *brl,
-  const unsigned char *bytes, size_t size,
-  size_t *length, void *data
-) {
-  unsigned char byte = bytes[size-1];
-
-  switch (size) {
-    case 1: {
-      switch (byte) {
-        case 0X1C:
-          *length = 4;
-          break;
-
-        case 0XFA:
-          *length = 10;
-          break;
-
-        default:
-          return BRL_PVR_INVALID;
-      }
-
-      break;
-    }
-
-    default:
-      break;
-  }
-
-  if (size == *length) {
-    switch (bytes[0]) {
-      case 0X1C: {
-        if (byte != 0X1F) return BRL_PVR_INVALID;
-        break;
-      }
-
-      case 0XFA: {
-        if (byte != 0XFB) return BRL_PVR_INVALID;
-
-        const InputPacket *packet = (const void *)bytes;
-        int checksum = -packet->data.checksum;
-        for (size_t i=0; i<size; i+=1) checksum += packet->bytes[i];
-
-        if ((checksum & 0XFF) != packet->data.checksum) {
-          logInputProblem("incorrect input checksum", packet->bytes, size);
-          return BRL_PVR_INVALID;
-        }
+static const BraillePacketFormat cursorPacketFormat = {
+  .length = 4,
+  .hasTerminator = 1,
+  .terminator = 0X1F
+};
 
-        break;
-      }
+static const BraillePacketFormat dataPacketFormat = {
+  .length = 10,
+  .hasTerminator = 1,
+  .terminator = 0XFB,
+  .checksum = BRL_PKT_CHECKSUM_SUM
+};
 
-      default:
-        break;
-    }
+static const BraillePacketGrammar packetGrammar = {
+  .formats = {
+    [0X1C] = &cursorPacketFormat,
+    [0XFA] = &dataPacketFormat
   }
-
-  return BRL_PVR_INCLUDE;
-}
+};
 
 static size_t
 readPacket (BrailleDisplay *brl, InputPacket *packet) {
-  return readBraillePacket(brl, NULL, packet, sizeof(*packet), verifyPacket, NULL);
+  return readFramedBraillePacket(brl, NULL, packet, sizeof(*packet), &packetGrammar);
 }
 
 static size_t
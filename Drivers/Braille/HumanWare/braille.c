@@ -650,6 +650,7 @@ connectResource (BrailleDisplay *brl, const char *identifier) {
   descriptor.serial.parameters = &serialParameters;
   descriptor.serial.options.applicationData = &serialProtocol;
   descriptor.serial.options.readyDelay = OPEN_READY_DELAY;
+  descriptor.serial.options.inputBufferSize = 0X100;
 
   descriptor.usb.channelDefinitions = usbChannelDefinitions;
   descriptor.usb.options.readyDelay = OPEN_READY_DELAY;
@@ -39,6 +39,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "log.h"
 #include "bitfield.h"
@@ -100,6 +101,7 @@ typedef struct {
   void (*writeStatus) (BrailleDisplay *brl, unsigned int start, unsigned int count);
   void (*flushCells) (BrailleDisplay *brl);
   int (*setFirmness) (BrailleDisplay *brl, BrailleFirmness setting);
+  unsigned int writeOverhead;
 } ProtocolOperations;
 
 typedef enum {
@@ -521,7 +523,8 @@ static const ProtocolOperations protocolOperations1 = {
   initializeTerminal1, releaseResources1,
   readCommand1,
   writeText1, writeStatus1, flushCells1,
-  NULL
+  NULL,
+  7 /* STX, command, address, length, ETX */
 };
 
 static int
@@ -896,7 +899,8 @@ static const ProtocolOperations protocolOperations2 = {
   initializeTerminal2, releaseResources2,
   readCommand2,
   writeCells2, writeCells2, flushCells2,
-  setFirmness2
+  setFirmness2,
+  UINT_MAX /* the whole display is always rewritten */
 };
 
 typedef struct {
@@ -1166,10 +1170,16 @@ updateCells (
   unsigned int count, const unsigned char *data, unsigned char *cells,
   void (*writeCells) (BrailleDisplay *brl, unsigned int start, unsigned int count)
 ) {
-  unsigned int from, to;
+  BrailleCellRange ranges[BRL_CELL_RANGE_LIMIT];
+  unsigned int rangeCount = cellRangesHaveChanged(
+    cells, data, count, ranges, ARRAY_COUNT(ranges),
+    brl->data->protocol->writeOverhead, NULL
+  );
 
-  if (cellsHaveChanged(cells, data, count, &from, &to, NULL)) {
-    writeCells(brl, from, to-from);
+  for (unsigned int index=0; index<rangeCount; index+=1) {
+    const BrailleCellRange *range = &ranges[index];
+
+    writeCells(brl, range->from, range->to-range->from);
   }
 }
 
@@ -82,6 +82,35 @@ static const char *inputDelimiters = " ";
 static char outputBuffer[OUTPUT_SIZE];
 static size_t outputLength;
 
+/* Once the display has sent the "binary" command, everything in both
+ * directions is a frame: a type byte, a two-byte (big-endian) payload
+ * length, and then the payload.
+ */
+typedef enum {
+  FRAME_CELLS   = 'C', /* display: text columns, text rows, status columns, status rows */
+  FRAME_COMMAND = 'K', /* display: command code */
+  FRAME_QUIT    = 'Q', /* display: (empty) */
+
+  FRAME_BRAILLE = 'B', /* driver: first cell, dots */
+  FRAME_VISUAL  = 'V', /* driver: first character, UTF-8 text */
+  FRAME_STATUS  = 'S', /* driver: first cell, dots */
+  FRAME_GENERIC = 'G'  /* driver: (index, value) pairs */
+} FrameType;
+
+#define FRAME_HEADER_SIZE 3
+#define FRAME_OFFSET_SIZE 2
+#define FRAME_OVERHEAD (FRAME_HEADER_SIZE + FRAME_OFFSET_SIZE)
+#define FRAME_PAYLOAD_LIMIT 0XFFFF
+#define FRAME_CHARACTER_LIMIT 0X100
+
+typedef struct {
+  unsigned char type;
+  size_t length;
+  unsigned char payload[INPUT_SIZE];
+} InputFrame;
+
+static int binaryMode;
+
 typedef struct {
   const CommandEntry *entry;
   unsigned int count;
@@ -568,6 +597,18 @@ copyString (const char *string) {
   return makeString(string, strlen(string));
 }
 
+static int
+isNoInputError (int error) {
+  /* awaitSocketInput() reports that nothing has arrived as a timeout. */
+  if (error == EAGAIN) return 1;
+
+#ifdef ETIMEDOUT
+  if (error == ETIMEDOUT) return 1;
+#endif /* ETIMEDOUT */
+
+  return 0;
+}
+
 static int
 fillInputBuffer (void) {
   if ((inputLength < INPUT_SIZE) && !inputEnd) {
@@ -576,7 +617,7 @@ fillInputBuffer (void) {
       inputEnd = 1;
     } else if (count != -1) {
       inputLength += count;
-    } else if (errno != EAGAIN) {
+    } else if (!isNoInputError(errno)) {
       return 0;
     }
   }
@@ -625,6 +666,40 @@ readCommandLine (void) {
   return NULL;
 }
 
+static int
+readFrame (InputFrame *frame) {
+  if (fillInputBuffer()) {
+    if (inputLength >= FRAME_HEADER_SIZE) {
+      const unsigned char *header = (const unsigned char *)inputBuffer;
+      size_t length = (header[1] << 8) | header[2];
+      size_t size = FRAME_HEADER_SIZE + length;
+
+      if (size > INPUT_SIZE) {
+        logMessage(LOG_WARNING, "frame too long: %u", (unsigned int)length);
+        inputLength = 0;
+        inputEnd = 1;
+      } else if (size <= inputLength) {
+        frame->type = header[0];
+        frame->length = length;
+        memcpy(frame->payload, &header[FRAME_HEADER_SIZE], length);
+
+        inputLength -= size;
+        memmove(inputBuffer, &inputBuffer[size], inputLength);
+        return 1;
+      }
+    }
+
+    if (inputEnd) {
+      frame->type = FRAME_QUIT;
+      frame->length = 0;
+      inputLength = 0;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
 static const char *
 nextWord (void) {
   return strtok(NULL, inputDelimiters);
@@ -753,6 +828,89 @@ writeLine (void) {
   return 0;
 }
 
+static int
+writeFrameHeader (FrameType type, size_t length) {
+  const char header[FRAME_HEADER_SIZE] = {
+    type, ((length >> 8) & 0XFF), (length & 0XFF)
+  };
+
+  return writeBytes(header, sizeof(header));
+}
+
+static int
+writeFrameOffset (FrameType type, size_t length, unsigned int offset) {
+  const char bytes[FRAME_OFFSET_SIZE] = {
+    ((offset >> 8) & 0XFF), (offset & 0XFF)
+  };
+
+  if (!writeFrameHeader(type, (FRAME_OFFSET_SIZE + length))) return 0;
+  return writeBytes(bytes, sizeof(bytes));
+}
+
+static int
+writeCellsFrame (FrameType type, unsigned int offset, const unsigned char *cells, unsigned int count) {
+  while (count > 0) {
+    unsigned int length = MIN(count, (FRAME_PAYLOAD_LIMIT - FRAME_OFFSET_SIZE));
+
+    if (!writeFrameOffset(type, length, offset)) return 0;
+    if (!writeBytes((const char *)cells, length)) return 0;
+
+    offset += length;
+    cells += length;
+    count -= length;
+  }
+
+  return 1;
+}
+
+static int
+writeCellRanges (FrameType type, const unsigned char *cells, const BrailleCellRange *ranges, unsigned int count) {
+  while (count-- > 0) {
+    if (!writeCellsFrame(type, ranges->from, &cells[ranges->from], (ranges->to - ranges->from))) return 0;
+    ranges += 1;
+  }
+
+  return 1;
+}
+
+static int
+writeVisualFrame (unsigned int offset, const wchar_t *characters, unsigned int count) {
+  while (count > 0) {
+    unsigned int limit = MIN(count, FRAME_CHARACTER_LIMIT);
+    char buffer[limit * UTF8_LEN_MAX];
+    size_t length = 0;
+    unsigned int index;
+
+    for (index=0; index<limit; index+=1) {
+      Utf8Buffer utf8;
+      size_t size = convertWcharToUtf8(characters[index], utf8);
+
+      memcpy(&buffer[length], utf8, size);
+      length += size;
+    }
+
+    if (!writeFrameOffset(FRAME_VISUAL, length, offset)) return 0;
+    if (!writeBytes(buffer, length)) return 0;
+
+    offset += limit;
+    characters += limit;
+    count -= limit;
+  }
+
+  return 1;
+}
+
+static int
+startBinaryMode (void) {
+  writeString("Binary");
+  if (!writeLine()) return 0;
+
+  binaryMode = 1;
+  inputStart = 0;
+  logMessage(LOG_DEBUG, "binary mode started");
+  return 1;
+}
+
 static void
 sortCommands (int (*compareCommands) (const void *item1, const void *item2)) {
   qsort(commandDescriptors, commandCount, commandSize, compareCommands);
@@ -854,6 +1012,54 @@ findCommand (const char *name) {
   return bsearch(name, commandDescriptors, commandCount, commandSize, compareCommandName);
 }
 
+static int
+setDimensions (BrailleDisplay *brl, int columns1, int rows1, int columns2, int rows2) {
+  int count1 = columns1 * rows1;
+  int count2 = columns2 * rows2;
+  unsigned char *braille;
+  wchar_t *text;
+  unsigned char *status;
+
+  if ((braille = calloc(count1, sizeof(*braille)))) {
+    if ((text = calloc(count1, sizeof(*text)))) {
+      if ((status = calloc(count2, sizeof(*status)))) {
+        brailleColumns = columns1;
+        brailleRows = rows1;
+        brailleCount = count1;
+
+        statusColumns = columns2;
+        statusRows = rows2;
+        statusCount = count2;
+
+        if (brailleCells) free(brailleCells);
+        brailleCells = braille;
+        memset(brailleCells, 0, count1);
+
+        if (textCharacters) free(textCharacters);
+        textCharacters = text;
+        wmemset(textCharacters, WC_C(' '), count1);
+
+        if (statusCells) free(statusCells);
+        statusCells = status;
+        memset(statusCells, 0, count2);
+        memset(genericCells, 0, GSC_COUNT);
+
+        brl->textColumns = brailleColumns;
+        brl->textRows = brailleRows;
+        brl->statusColumns = statusColumns;
+        brl->statusRows = statusRows;
+        return 1;
+      }
+
+      free(text);
+    }
+
+    free(braille);
+  }
+
+  return 0;
+}
+
 static int
 dimensionsChanged (BrailleDisplay *brl) {
   int ok = 1;
@@ -901,52 +1107,40 @@ dimensionsChanged (BrailleDisplay *brl) {
     ok = 0;
   }
 
-  if (ok) {
-    int count1 = columns1 * rows1;
-    int count2 = columns2 * rows2;
-    unsigned char *braille;
-    wchar_t *text;
-    unsigned char *status;
-
-    if ((braille = calloc(count1, sizeof(*braille)))) {
-      if ((text = calloc(count1, sizeof(*text)))) {
-        if ((status = calloc(count2, sizeof(*status)))) {
-          brailleColumns = columns1;
-          brailleRows = rows1;
-          brailleCount = count1;
-
-          statusColumns = columns2;
-          statusRows = rows2;
-          statusCount = count2;
-
-          if (brailleCells) free(brailleCells);
-          brailleCells = braille;
-          memset(brailleCells, 0, count1);
-
-          if (textCharacters) free(textCharacters);
-          textCharacters = text;
-          wmemset(textCharacters, WC_C(' '), count1);
-
-          if (statusCells) free(statusCells);
-          statusCells = status;
-          memset(statusCells, 0, count2);
-          memset(genericCells, 0, GSC_COUNT);
-
-          brl->textColumns = brailleColumns;
-          brl->textRows = brailleRows;
-          brl->statusColumns = statusColumns;
-          brl->statusRows = statusRows;
-          return 1;
-        }
+  return ok && setDimensions(brl, columns1, rows1, columns2, rows2);
+}
 
-        free(text);
-      }
+static int
+getFrameInteger (const InputFrame *frame, unsigned int index, int *value) {
+  unsigned int offset = index * 2;
 
-      free(braille);
-    }
+  if ((offset + 2) > frame->length) return 0;
+  *value = (frame->payload[offset] << 8) | frame->payload[offset+1];
+  return 1;
+}
+
+static int
+cellsFrameReceived (BrailleDisplay *brl, const InputFrame *frame) {
+  int columns1;
+  int rows1 = 1;
+  int columns2 = 0;
+  int rows2 = 1;
+
+  if (!getFrameInteger(frame, 0, &columns1) || (columns1 < 1)) {
+    logMessage(LOG_WARNING, "invalid text column count");
+    return 0;
   }
 
-  return 0;
+  if (getFrameInteger(frame, 1, &rows1) && (rows1 < 1)) {
+    logMessage(LOG_WARNING, "invalid text row count: %d", rows1);
+    return 0;
+  }
+
+  getFrameInteger(frame, 2, &columns2);
+  getFrameInteger(frame, 3, &rows2);
+  if (!columns2) rows2 = 0;
+
+  return setDimensions(brl, columns1, rows1, columns2, rows2);
 }
 
 static int
@@ -957,6 +1151,7 @@ brl_construct (BrailleDisplay *brl, char **parameters, const char *device) {
   inputStart = 0;
   inputEnd = 0;
   outputLength = 0;
+  binaryMode = 0;
 
   if (isQualifiedDevice(&device, "client")) {
     static const ModeEntry clientModeEntry = {
@@ -1022,8 +1217,26 @@ brl_construct (BrailleDisplay *brl, char **parameters, const char *device) {
     char *line = NULL;
 
     while (1) {
-      if (line) free(line);
-      if ((line = readCommandLine())) {
+      if (line) {
+        free(line);
+        line = NULL;
+      }
+
+      if (binaryMode) {
+        InputFrame frame;
+
+        if (readFrame(&frame)) {
+          if (frame.type == FRAME_CELLS) {
+            if (cellsFrameReceived(brl, &frame)) return 1;
+          } else if (frame.type == FRAME_QUIT) {
+            break;
+          } else {
+            logMessage(LOG_WARNING, "unexpected frame: %02X", frame.type);
+          }
+        } else {
+          asyncWait(1000);
+        }
+      } else if ((line = readCommandLine())) {
         const char *word;
         logMessage(LOG_DEBUG, "command received: %s", line);
 
@@ -1033,6 +1246,8 @@ brl_construct (BrailleDisplay *brl, char **parameters, const char *device) {
               free(line);
               return 1;
             }
+          } else if (testWord(word, "binary")) {
+            startBinaryMode();
           } else if (testWord(word, "quit")) {
             break;
           } else {
@@ -1081,6 +1296,30 @@ brl_destruct (BrailleDisplay *brl) {
 
 static int
 brl_writeWindow (BrailleDisplay *brl, const wchar_t *text) {
+  if (binaryMode) {
+    BrailleCellRange ranges[BRL_CELL_RANGE_LIMIT];
+    unsigned int count;
+
+    if (text) {
+      const BrailleCellRange *range = ranges;
+
+      count = textRangesHaveChanged(textCharacters, text, brailleCount,
+                                    ranges, ARRAY_COUNT(ranges), FRAME_OVERHEAD, NULL);
+
+      while (count-- > 0) {
+        writeVisualFrame(range->from, &textCharacters[range->from], (range->to - range->from));
+        range += 1;
+      }
+    }
+
+    count = cellRangesHaveChanged(brailleCells, brl->buffer, brailleCount,
+                                  ranges, ARRAY_COUNT(ranges), FRAME_OVERHEAD, NULL);
+    writeCellRanges(FRAME_BRAILLE, brailleCells, ranges, count);
+
+    flushOutput();
+    return 1;
+  }
+
   if (text) {
     if (wmemcmp(text, textCharacters, brailleCount) != 0) {
       const wchar_t *address = text;
@@ -1133,6 +1372,39 @@ brl_writeStatus (BrailleDisplay *brl, const unsigned char *status) {
     count = statusCount;
   }
 
+  if (binaryMode) {
+    if (generic) {
+      int all = cells[GSC_FIRST] != GSC_MARKER;
+      char pairs[(GSC_COUNT - 1) * 2];
+      size_t length = 0;
+      int i;
+
+      for (i=1; i<count; i+=1) {
+        if (all || (status[i] != cells[i])) {
+          pairs[length++] = i;
+          pairs[length++] = status[i];
+        }
+      }
+
+      memcpy(cells, status, count);
+
+      if (length) {
+        writeFrameHeader(FRAME_GENERIC, length);
+        writeBytes(pairs, length);
+      }
+    } else {
+      BrailleCellRange ranges[BRL_CELL_RANGE_LIMIT];
+      unsigned int rangeCount = cellRangesHaveChanged(cells, status, count,
+                                                      ranges, ARRAY_COUNT(ranges),
+                                                      FRAME_OVERHEAD, NULL);
+
+      writeCellRanges(FRAME_STATUS, cells, ranges, rangeCount);
+    }
+
+    flushOutput();
+    return 1;
+  }
+
   if (cellsHaveChanged(cells, status, count, NULL, NULL, NULL)) {
     if (generic) {
       int all = cells[GSC_FIRST] != GSC_MARKER;
@@ -1191,10 +1463,44 @@ brl_writeStatus (BrailleDisplay *brl, const unsigned char *status) {
   return 1;
 }
 
+static int
+readBinaryCommand (BrailleDisplay *brl) {
+  InputFrame frame;
+
+  if (readFrame(&frame)) {
+    switch (frame.type) {
+      case FRAME_COMMAND:
+        if (frame.length == 4) {
+          return (frame.payload[0] << 24) | (frame.payload[1] << 16) |
+                 (frame.payload[2] << 8) | frame.payload[3];
+        }
+
+        logMessage(LOG_WARNING, "invalid command frame length: %u", (unsigned int)frame.length);
+        break;
+
+      case FRAME_CELLS:
+        if (cellsFrameReceived(brl, &frame)) brl->resizeRequired = 1;
+        break;
+
+      case FRAME_QUIT:
+        return BRL_CMD_RESTARTBRL;
+
+      default:
+        logMessage(LOG_WARNING, "unexpected frame: %02X", frame.type);
+        break;
+    }
+  }
+
+  return EOF;
+}
+
 static int
 brl_readCommand (BrailleDisplay *brl, KeyTableCommandContext context) {
   int command = EOF;
-  char *line = readCommandLine();
+  char *line;
+
+  if (binaryMode) return readBinaryCommand(brl);
+  line = readCommandLine();
 
   if (line) {
     const char *word;
@@ -1203,6 +1509,8 @@ brl_readCommand (BrailleDisplay *brl, KeyTableCommandContext context) {
     if ((word = strtok(line, inputDelimiters))) {
       if (testWord(word, "cells")) {
         if (dimensionsChanged(brl)) brl->resizeRequired = 1;
+      } else if (testWord(word, "binary")) {
+        startBinaryMode();
       } else if (testWord(word, "quit")) {
         command = BRL_CMD_RESTARTBRL;
       } else {
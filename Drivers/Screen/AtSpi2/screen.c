@@ -95,6 +95,15 @@ static char *curPath;
 static long curNumRows, curNumCols;
 static wchar_t **curRows;
 static long *curRowLengths;
+
+/* Fenwick tree of the row lengths, for finding the row of a text offset in
+ * logarithmic time. It is updated in place when a row's length changes or
+ * when rows are added or removed, and rebuilt on the next lookup after the
+ * whole text has been replaced.
+ */
+static long *curRowOffsets;
+static long curRowOffsetsSize;
+static int curRowOffsetsValid;
 static long curCaret,curPosX,curPosY;
 
 static DBusConnection *bus = NULL;
@@ -226,12 +235,82 @@ static size_t my_mbslen(const char *s, size_t n) {
   return ret;
 }
 
+static void invalidateRowOffsets(void) {
+  curRowOffsetsValid = 0;
+}
+
+static int allocateRowOffsets(void) {
+  if (curNumRows+1 > curRowOffsetsSize) {
+    long size = curNumRows+1;
+    long *offsets = realloc(curRowOffsets,size*sizeof(*offsets));
+    if (!offsets) {
+      logMallocError();
+      return 0;
+    }
+    curRowOffsets = offsets;
+    curRowOffsetsSize = size;
+  }
+  return 1;
+}
+
+static int buildRowOffsets(void) {
+  long i;
+  if (!allocateRowOffsets())
+    return 0;
+  curRowOffsets[0] = 0;
+  for (i=1; i<=curNumRows; i++)
+    curRowOffsets[i] = curRowLengths[i-1];
+  for (i=1; i<=curNumRows; i++) {
+    long parent = i + (i & -i);
+    if (parent <= curNumRows)
+      curRowOffsets[parent] += curRowOffsets[i];
+  }
+  curRowOffsetsValid = 1;
+  return 1;
+}
+
+/* Rows from pos onwards have moved. The nodes before them only cover rows
+ * which haven't, and each of the others is its own row's length plus the
+ * nodes just below it, so they can be recomputed in order. This costs no
+ * more than moving the rows did.
+ */
+static void shiftRowOffsets(long pos) {
+  long i;
+  if (!curRowOffsetsValid)
+    return;
+  if (!allocateRowOffsets()) {
+    invalidateRowOffsets();
+    return;
+  }
+  for (i=pos+1; i<=curNumRows; i++) {
+    long step;
+    curRowOffsets[i] = curRowLengths[i-1];
+    for (step=1; step<(i&-i); step<<=1)
+      curRowOffsets[i] += curRowOffsets[i-step];
+  }
+}
+
+static void setRowLength(long y, long length) {
+  if (curRowOffsetsValid) {
+    long delta = length - curRowLengths[y];
+    long i;
+    for (i=y+1; i<=curNumRows; i+=i&-i)
+      curRowOffsets[i] += delta;
+  }
+  curRowLengths[y] = length;
+}
+
 static void addRows(long pos, long num) {
+  long y;
   curNumRows += num;
   curRows = realloc(curRows,curNumRows*sizeof(*curRows));
   curRowLengths = realloc(curRowLengths,curNumRows*sizeof(*curRowLengths));
   memmove(curRows      +pos+num,curRows      +pos,(curNumRows-(pos+num))*sizeof(*curRows));
   memmove(curRowLengths+pos+num,curRowLengths+pos,(curNumRows-(pos+num))*sizeof(*curRowLengths));
+  /* the new rows are empty until setRowLength() is called for them */
+  for (y=pos;y<pos+num;y++)
+    curRowLengths[y] = 0;
+  shiftRowOffsets(pos);
 }
 
 static void delRows(long pos, long num) {
@@ -243,6 +322,8 @@ static void delRows(long pos, long num) {
   curNumRows -= num;
   curRows = realloc(curRows,curNumRows*sizeof(*curRows));
   curRowLengths = realloc(curRowLengths,curNumRows*sizeof(*curRowLengths));
+  if (num)
+    shiftRowOffsets(pos);
 }
 
 static int
@@ -362,10 +443,23 @@ send_with_reply_and_block(DBusConnection *bus, DBusMessage *msg, int timeout_ms,
 static void findPosition(long position, long *px, long *py) {
   long offset=0, newoffset, x, y;
   /* XXX: I don't know what they do with necessary combining accents */
-  for (y=0; y<curNumRows; y++) {
-    if ((newoffset = offset + curRowLengths[y]) > position)
-      break;
-    offset = newoffset;
+  if (curRowOffsetsValid || buildRowOffsets()) {
+    /* descend the tree for the last row starting at or before position */
+    long step = 1;
+    while (step <= curNumRows/2)
+      step <<= 1;
+    for (y=0; step; step>>=1) {
+      if (y+step <= curNumRows && offset+curRowOffsets[y+step] <= position) {
+        y += step;
+        offset += curRowOffsets[y];
+      }
+    }
+  } else {
+    for (y=0; y<curNumRows; y++) {
+      if ((newoffset = offset + curRowLengths[y]) > position)
+        break;
+      offset = newoffset;
+    }
   }
   if (y==curNumRows) {
     if (!curNumRows) {
@@ -384,6 +478,18 @@ static void findPosition(long position, long *px, long *py) {
   *py = y;
 }
 
+static long getCachedTextLength(void) {
+  long length = 0, y;
+  if (curRowOffsetsValid || buildRowOffsets()) {
+    for (y=curNumRows; y; y-=y&-y)
+      length += curRowOffsets[y];
+  } else {
+    for (y=0; y<curNumRows; y++)
+      length += curRowLengths[y];
+  }
+  return length;
+}
+
 static void caretPosition(long caret) {
   findPosition(caret,&curPosX,&curPosY);
   curCaret = caret;
@@ -399,6 +505,7 @@ static void finiTerm(void) {
   curPosX = curPosY = 0;
   free(curRows);
   curRows = NULL;
+  invalidateRowOffsets();
   curNumCols = curNumRows = 0;
 }
 
@@ -461,43 +568,52 @@ out:
   return res;
 }
 
-/* Get the caret of an AT-SPI2 object */
-static dbus_int32_t getCaret(const char *sender, const char *path) {
+/* Get an integer property of the text of an AT-SPI2 object */
+static dbus_int32_t getTextProperty(const char *sender, const char *path, const char *property) {
   dbus_int32_t res = -1;
   DBusMessage *msg, *reply = NULL;
   const char *interface = SPI2_DBUS_INTERFACE_TEXT;
-  const char *property = "CaretOffset";
   DBusMessageIter iter, iter_variant;
 
   msg = new_method_call(sender, path, FREEDESKTOP_DBUS_INTERFACE_PROP, "Get");
   if (!msg)
     return -1;
   dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID);
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting caret");
+  reply = send_with_reply_and_block(bus, msg, 1000, property);
   if (!reply)
     return -1;
 
   dbus_message_iter_init(reply, &iter);
   if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_VARIANT) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
-               "getText didn't return a variant but '%c'", dbus_message_iter_get_arg_type(&iter));
+               "%s didn't return a variant but '%c'", property, dbus_message_iter_get_arg_type(&iter));
     goto out;
   }
   dbus_message_iter_recurse(&iter, &iter_variant);
   if (dbus_message_iter_get_arg_type(&iter_variant) != DBUS_TYPE_INT32) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
-               "getText didn't return an int32 but '%c'", dbus_message_iter_get_arg_type(&iter_variant));
+               "%s didn't return an int32 but '%c'", property, dbus_message_iter_get_arg_type(&iter_variant));
     goto out;
   }
   dbus_message_iter_get_basic(&iter_variant, &res);
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
-             "Got caret %d", res);
+             "Got %s %d", property, res);
 
 out:
   dbus_message_unref(reply);
   return res;
 }
 
+/* Get the caret of an AT-SPI2 object */
+static dbus_int32_t getCaret(const char *sender, const char *path) {
+  return getTextProperty(sender, path, "CaretOffset");
+}
+
+/* Get the length of the text of an AT-SPI2 object */
+static dbus_int32_t getCharacterCount(const char *sender, const char *path) {
+  return getTextProperty(sender, path, "CharacterCount");
+}
+
 /* Switched to a new terminal, restart from scratch */
 static void restartTerm(const char *sender, const char *path) {
   char *c,*d;
@@ -524,6 +640,7 @@ static void restartTerm(const char *sender, const char *path) {
   }
   curNumRows = 0;
   free(curRowLengths);
+  invalidateRowOffsets();
   c = text;
   while (*c) {
     curNumRows++;
@@ -568,6 +685,22 @@ static void restartTerm(const char *sender, const char *path) {
 }
 
 /* Switched to a new object, check whether we want to read it, and if so, restart with it */
+/* The text of the current terminal is kept up to date by applying the
+ * TextChanged events to it, so when focus comes back to it only its length
+ * is checked against the object's before trusting it again. */
+static int isCurrentTermConsistent(const char *sender, const char *path) {
+  dbus_int32_t count;
+  if (!curPath || strcmp(sender, curSender) || strcmp(path, curPath))
+    return 0;
+  count = getCharacterCount(sender, path);
+  if (count < 0 || count != getCachedTextLength()) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "cached text length %ld doesn't match %d",getCachedTextLength(),count);
+    return 0;
+  }
+  return 1;
+}
+
 static void tryRestartTerm(const char *sender, const char *path) {
   char *role = getRole(sender, path);
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
@@ -575,7 +708,12 @@ static void tryRestartTerm(const char *sender, const char *path) {
   if (typeFlags[TYPE_ALL] ||
       (role && typeFlags[TYPE_TEXT] && (strcmp(role, "text") == 0)) ||
       (role && typeFlags[TYPE_TERMINAL] && (strcmp(role, "terminal") == 0))) {
-    restartTerm(sender, path);
+    if (isCurrentTermConsistent(sender, path)) {
+      logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+                 "keeping cached text of %s:%s",sender,path);
+      caretPosition(getCaret(sender, path));
+    } else
+      restartTerm(sender, path);
   } else {
     if (curPath)
       finiTerm();
@@ -849,6 +987,13 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     dbus_message_iter_get_basic(&iter_variant, &deleted);
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "'%s'",deleted);
+    if (detail1 < 0 || detail2 < 0 || detail1+detail2 > getCachedTextLength()) {
+      logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+                 "deletion doesn't match cached text, refetching it");
+      restartTerm(sender, path);
+      updated = 1;
+      return;
+    }
     downTo = y;
     if (downTo < curNumRows)
       length = curRowLengths[downTo];
@@ -869,13 +1014,13 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     if (length-toDelete>0) {
       /* still something on line y */
       if (y!=downTo) {
-	curRowLengths[y] = length-toDelete;
+	setRowLength(y, length-toDelete);
 	curRows[y]=realloc(curRows[y],curRowLengths[y]*sizeof(*curRows[y]));
       }
       if ((toCopy = length-toDelete-x))
 	memmove(curRows[y]+x,curRows[downTo]+curRowLengths[downTo]-toCopy,toCopy*sizeof(*curRows[downTo]));
       if (y==downTo) {
-	curRowLengths[y] = length-toDelete;
+	setRowLength(y, length-toDelete);
 	curRows[y]=realloc(curRows[y],curRowLengths[y]*sizeof(*curRows[y]));
       }
     } else {
@@ -903,12 +1048,20 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
     dbus_message_iter_get_basic(&iter_variant, &added);
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "'%s'",added);
+    if (detail1 < 0 || detail2 < 0 || detail1 > getCachedTextLength() ||
+        (long)my_mbslen(added,strlen(added)) != detail2) {
+      logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+                 "insertion doesn't match cached text, refetching it");
+      restartTerm(sender, path);
+      updated = 1;
+      return;
+    }
     adding = c = added;
     if (x && (c = strchr(adding,'\n'))) {
       /* splitting line */
       addRows(y,1);
       semilen=my_mbslen(adding,c+1-adding);
-      curRowLengths[y]=x+semilen;
+      setRowLength(y, x+semilen);
       if (x+semilen-1>curNumCols)
 	curNumCols=x+semilen-1;
 
@@ -920,7 +1073,7 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
       len-=semilen;
       adding=c+1;
       /* shift end */
-      curRowLengths[y+1]-=x;
+      setRowLength(y+1, curRowLengths[y+1]-x);
       memmove(curRows[y+1],curRows[y+1]+x,curRowLengths[y+1]*sizeof(*curRows[y+1]));
       x=0;
       y++;
@@ -929,7 +1082,7 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
       /* adding lines */
       addRows(y,1);
       semilen=my_mbslen(adding,c+1-adding);
-      curRowLengths[y]=semilen;
+      setRowLength(y, semilen);
       if (semilen-1>curNumCols)
 	curNumCols=semilen-1;
       curRows[y]=malloc(semilen*sizeof(*curRows[y]));
@@ -944,9 +1097,9 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
 	/* It won't insert ending \n yet */
 	addRows(y,1);
 	curRows[y]=NULL;
-	curRowLengths[y]=0;
+	setRowLength(y, 0);
       }
-      curRowLengths[y] += len;
+      setRowLength(y, curRowLengths[y]+len);
       curRows[y]=realloc(curRows[y],curRowLengths[y]*sizeof(*curRows[y]));
       memmove(curRows[y]+x+len,curRows[y]+x,(curRowLengths[y]-(x+len))*sizeof(*curRows[y]));
       my_mbsrtowcs(curRows[y]+x,&adding,len,NULL);
@@ -1252,6 +1405,10 @@ destruct_AtSpi2Screen (void) {
   dbus_connection_remove_filter(bus, AtSpi2Filter, NULL);
   dbus_connection_close(bus);
   dbus_connection_unref(bus);
+  free(curRowOffsets);
+  curRowOffsets = NULL;
+  curRowOffsetsSize = 0;
+  curRowOffsetsValid = 0;
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "SPI2 stopped");
 }
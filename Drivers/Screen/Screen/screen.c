@@ -19,6 +19,7 @@
 #include "prologue.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
@@ -45,12 +46,247 @@ static int shmFileDescriptor = -1;
 #include "ascii.h"
 
 #include "scr_driver.h"
-#include "screen.h"
+#include "scr_shm.h"
 
 static unsigned char *shmAddress = NULL;
+static size_t shmSegmentSize = 0;
 static const mode_t shmMode = S_IRWXU;
 static const int shmSize = 4 + ((66 * 132) * 2);
 
+/* When the writer uses version 2 of the shared screen image, the screen is
+ * read from a private copy which is only brought up to date (under the
+ * segment's sequence counter) when the screen is described.
+ */
+#define SCREEN_SNAPSHOT_RETRY_LIMIT 5
+
+static const ScreenSegmentHeader *screenSegment = NULL;
+
+typedef struct {
+  uint32_t *text;
+  unsigned char *attributes;
+  size_t size;
+} ScreenPlanes;
+
+static struct {
+  unsigned char valid;
+  uint32_t generation;
+
+  unsigned int rows;
+  unsigned int columns;
+  unsigned int cursorRow;
+  unsigned int cursorColumn;
+  unsigned int number;
+  unsigned int flags;
+
+  ScreenPlanes current;
+  ScreenPlanes scratch;
+
+  unsigned int *changedRows;
+  size_t changedRowsSize;
+} screenSnapshot;
+
+typedef struct {
+  unsigned int rows;
+  unsigned int columns;
+  unsigned int cursorRow;
+  unsigned int cursorColumn;
+  unsigned int number;
+  unsigned int flags;
+
+  unsigned char resized;
+  unsigned int changedCount;
+} ScreenCopy;
+
+static void
+releaseScreenPlanes (ScreenPlanes *planes) {
+  if (planes->text) free(planes->text);
+  if (planes->attributes) free(planes->attributes);
+}
+
+static void
+resetScreenSnapshot (void) {
+  releaseScreenPlanes(&screenSnapshot.current);
+  releaseScreenPlanes(&screenSnapshot.scratch);
+  if (screenSnapshot.changedRows) free(screenSnapshot.changedRows);
+  memset(&screenSnapshot, 0, sizeof(screenSnapshot));
+}
+
+static int
+resizeScreenPlanes (ScreenPlanes *planes, size_t size) {
+  if (size > planes->size) {
+    uint32_t *text;
+    unsigned char *attributes;
+
+    if (!(text = realloc(planes->text, ARRAY_SIZE(text, size)))) {
+      logMallocError();
+      return 0;
+    }
+    planes->text = text;
+
+    if (!(attributes = realloc(planes->attributes, ARRAY_SIZE(attributes, size)))) {
+      logMallocError();
+      return 0;
+    }
+    planes->attributes = attributes;
+
+    planes->size = size;
+  }
+
+  return 1;
+}
+
+static int
+resizeChangedRows (size_t size) {
+  if (size > screenSnapshot.changedRowsSize) {
+    unsigned int *rows = realloc(screenSnapshot.changedRows, ARRAY_SIZE(rows, size));
+
+    if (!rows) {
+      logMallocError();
+      return 0;
+    }
+
+    screenSnapshot.changedRows = rows;
+    screenSnapshot.changedRowsSize = size;
+  }
+
+  return 1;
+}
+
+/* The changed rows are copied into the scratch planes. They're only moved
+ * into the snapshot once the sequence counter shows that the writer didn't
+ * change anything while they were being copied.
+ */
+static int
+copyScreenSegment (ScreenCopy *copy) {
+  const ScreenSegmentHeader *header = screenSegment;
+  ScreenPlanes *scratch = &screenSnapshot.scratch;
+
+  copy->rows = header->rows;
+  copy->columns = header->columns;
+  copy->cursorRow = header->cursorRow;
+  copy->cursorColumn = header->cursorColumn;
+  copy->number = header->number;
+  copy->flags = header->flags;
+
+  if (copy->rows > header->rowLimit) return 0;
+  if ((copy->rows * copy->columns) > header->cellLimit) return 0;
+
+  copy->resized = !screenSnapshot.valid ||
+                  (copy->rows != screenSnapshot.rows) ||
+                  (copy->columns != screenSnapshot.columns);
+
+  if (!resizeScreenPlanes(scratch, (copy->rows * copy->columns))) return 0;
+  if (!resizeChangedRows(copy->rows)) return 0;
+  copy->changedCount = 0;
+
+  {
+    const uint32_t *generations = getScreenSegmentRowGenerations(header);
+    const uint32_t *text = getScreenSegmentText(header);
+    const unsigned char *attributes = getScreenSegmentAttributes(header);
+    unsigned int row;
+
+    for (row=0; row<copy->rows; row+=1) {
+      if (copy->resized || ((int32_t)(generations[row] - screenSnapshot.generation) > 0)) {
+        size_t offset = row * copy->columns;
+
+        memcpy(&scratch->text[offset], &text[offset],
+               ARRAY_SIZE(scratch->text, copy->columns));
+        memcpy(&scratch->attributes[offset], &attributes[offset],
+               ARRAY_SIZE(scratch->attributes, copy->columns));
+
+        screenSnapshot.changedRows[copy->changedCount++] = row;
+      }
+    }
+  }
+
+  return 1;
+}
+
+static void
+commitScreenCopy (const ScreenCopy *copy, uint32_t generation) {
+  ScreenPlanes *current = &screenSnapshot.current;
+  ScreenPlanes *scratch = &screenSnapshot.scratch;
+
+  if (copy->resized) {
+    ScreenPlanes planes = *current;
+
+    *current = *scratch;
+    *scratch = planes;
+  } else {
+    unsigned int index;
+
+    for (index=0; index<copy->changedCount; index+=1) {
+      size_t offset = screenSnapshot.changedRows[index] * copy->columns;
+
+      memcpy(&current->text[offset], &scratch->text[offset],
+             ARRAY_SIZE(current->text, copy->columns));
+      memcpy(&current->attributes[offset], &scratch->attributes[offset],
+             ARRAY_SIZE(current->attributes, copy->columns));
+    }
+  }
+
+  screenSnapshot.rows = copy->rows;
+  screenSnapshot.columns = copy->columns;
+  screenSnapshot.cursorRow = copy->cursorRow;
+  screenSnapshot.cursorColumn = copy->cursorColumn;
+  screenSnapshot.number = copy->number;
+  screenSnapshot.flags = copy->flags;
+
+  screenSnapshot.generation = generation;
+  screenSnapshot.valid = 1;
+}
+
+static int
+updateScreenSnapshot (void) {
+  const ScreenSegmentHeader *header = screenSegment;
+  unsigned int attempts = 0;
+
+  while (attempts++ < SCREEN_SNAPSHOT_RETRY_LIMIT) {
+    uint32_t sequence = header->sequence;
+    uint32_t generation;
+    ScreenCopy copy;
+
+    SCREEN_SEGMENT_BARRIER();
+    if (sequence & 1) continue;
+
+    generation = header->generation;
+    if (screenSnapshot.valid && (generation == screenSnapshot.generation)) return 1;
+
+    if (copyScreenSegment(&copy)) {
+      SCREEN_SEGMENT_BARRIER();
+
+      if (header->sequence == sequence) {
+        commitScreenCopy(&copy, generation);
+        return 1;
+      }
+    }
+  }
+
+  /* Every attempt overlapped an update, so keep presenting the previous
+   * (consistent) snapshot until the next time.
+   */
+  logMessage(LOG_CATEGORY(SCREEN_DRIVER), "screen image busy");
+  return screenSnapshot.valid;
+}
+
+static int
+checkScreenSegment (size_t size) {
+  shmSegmentSize = size;
+  resetScreenSnapshot();
+
+  if (isScreenSegment(shmAddress, size)) {
+    screenSegment = (const ScreenSegmentHeader *)shmAddress;
+    logMessage(LOG_INFO, "Screen image version: %u", screenSegment->version);
+    return 1;
+  }
+
+  screenSegment = NULL;
+  if (size >= shmSize) return 1;
+
+  logMessage(LOG_WARNING, "Screen image too small: %lu", (unsigned long)size);
+  return 0;
+}
+
 static int
 construct_ScreenScreen (void) {
 #ifdef HAVE_SHMGET
@@ -78,10 +314,20 @@ construct_ScreenScreen (void) {
     while (keyCount > 0) {
       shmKey = keys[--keyCount];
       logMessage(LOG_DEBUG, "Trying shared memory key: 0X%" PRIkey, shmKey);
-      if ((shmIdentifier = shmget(shmKey, shmSize, shmMode)) != -1) {
+      if ((shmIdentifier = shmget(shmKey, 0, shmMode)) != -1) {
         if ((shmAddress = shmat(shmIdentifier, NULL, 0)) != (unsigned char *)-1) {
-          logMessage(LOG_INFO, "Screen image shared memory key: 0X%" PRIkey, shmKey);
-          return 1;
+          struct shmid_ds status;
+
+          if (shmctl(shmIdentifier, IPC_STAT, &status) != -1) {
+            if (checkScreenSegment(status.shm_segsz)) {
+              logMessage(LOG_INFO, "Screen image shared memory key: 0X%" PRIkey, shmKey);
+              return 1;
+            }
+          } else {
+            logSystemError("shmctl");
+          }
+
+          shmdt(shmAddress);
         } else {
           logMessage(LOG_WARNING, "Cannot attach shared memory segment 0X%" PRIkey ": %s",
                      shmKey, strerror(errno));
@@ -98,10 +344,17 @@ construct_ScreenScreen (void) {
 #ifdef HAVE_SHM_OPEN
   {
     if ((shmFileDescriptor = shm_open(shmPath, O_RDONLY, shmMode)) != -1) {
-      if ((shmAddress = mmap(0, shmSize, PROT_READ, MAP_SHARED, shmFileDescriptor, 0)) != MAP_FAILED) {
-        return 1;
+      struct stat status;
+
+      if (fstat(shmFileDescriptor, &status) != -1) {
+        if ((shmAddress = mmap(0, status.st_size, PROT_READ, MAP_SHARED, shmFileDescriptor, 0)) != MAP_FAILED) {
+          if (checkScreenSegment(status.st_size)) return 1;
+          munmap(shmAddress, status.st_size);
+        } else {
+          logSystemError("mmap");
+        }
       } else {
-        logSystemError("mmap");
+        logSystemError("fstat");
       }
 
       close(shmFileDescriptor);
@@ -112,6 +365,7 @@ construct_ScreenScreen (void) {
   }
 #endif /* HAVE_SHM_OPEN */
 
+  shmAddress = NULL;
   return 0;
 }
 
@@ -122,9 +376,27 @@ getAuxiliaryData (void) {
 
 static int
 currentVirtualTerminal_ScreenScreen (void) {
+  if (screenSegment) {
+    updateScreenSnapshot();
+    return screenSnapshot.number;
+  }
+
   return getAuxiliaryData()[0];
 }
 
+static unsigned char
+getScreenFlags (void) {
+  if (screenSegment) {
+    unsigned char flags = 0;
+
+    updateScreenSnapshot();
+    if (screenSnapshot.flags & SCREEN_SEGMENT_FLAG_APPLICATION_CURSOR_KEYS) flags |= 0X01;
+    return flags;
+  }
+
+  return getAuxiliaryData()[1];
+}
+
 static int
 doScreenCommand (const char *command, ...) {
   va_list args;
@@ -170,6 +442,23 @@ userVirtualTerminal_ScreenScreen (int number) {
 
 static void
 describe_ScreenScreen (ScreenDescription *description) {
+  if (screenSegment) {
+    if (updateScreenSnapshot()) {
+      description->cols = screenSnapshot.columns;
+      description->rows = screenSnapshot.rows;
+      description->posx = screenSnapshot.cursorColumn;
+      description->posy = screenSnapshot.cursorRow;
+      description->number = screenSnapshot.number;
+    } else {
+      description->unreadable = "screen image not ready";
+      description->cols = description->rows = 1;
+      description->posx = description->posy = 0;
+      description->number = 0;
+    }
+
+    return;
+  }
+
   description->cols = shmAddress[0];
   description->rows = shmAddress[1];
   description->posx = shmAddress[2];
@@ -182,6 +471,31 @@ readCharacters_ScreenScreen (const ScreenBox *box, ScreenCharacter *buffer) {
   ScreenDescription description;                 /* screen statistics */
   describe_ScreenScreen(&description);
   if (validateScreenBox(box, description.cols, description.rows)) {
+    if (screenSegment) {
+      ScreenCharacter *character = buffer;
+      int row;
+
+      if (!screenSnapshot.valid) {
+        setScreenMessage(box, buffer, description.unreadable);
+        return 1;
+      }
+
+      for (row=0; row<box->height; row+=1) {
+        size_t offset = ((box->top + row) * description.cols) + box->left;
+        const uint32_t *text = &screenSnapshot.current.text[offset];
+        const unsigned char *attributes = &screenSnapshot.current.attributes[offset];
+        int column;
+
+        for (column=0; column<box->width; column+=1) {
+          character->text = *text++;
+          character->attributes = *attributes++;
+          character += 1;
+        }
+      }
+
+      return 1;
+    }
+
     ScreenCharacter *character = buffer;
     unsigned char *text = shmAddress + 4 + (box->top * description.cols) + box->left;
     unsigned char *attributes = text + (description.cols * description.rows);
@@ -213,7 +527,7 @@ insertKey_ScreenScreen (ScreenKey key) {
   wchar_t character = key & SCR_KEY_CHAR_MASK;
 
   if (isSpecialKey(key)) {
-    const unsigned char flags = getAuxiliaryData()[1];
+    const unsigned char flags = getScreenFlags();
 
 #define KEY(key,string) case (key): sequence = (string); break
 #define CURSOR_KEY(key,string1,string2) KEY((key), ((flags & 0X01)? (string1): (string2)))
@@ -293,13 +607,15 @@ destruct_ScreenScreen (void) {
 
 #ifdef HAVE_SHM_OPEN
   if (shmFileDescriptor != -1) {
-    munmap(shmAddress, shmSize);
+    munmap(shmAddress, shmSegmentSize);
     close(shmFileDescriptor);
     shmFileDescriptor = -1;
   }
 #endif /* HAVE_SHM_OPEN */
 
   shmAddress = NULL;
+  screenSegment = NULL;
+  resetScreenSnapshot();
 }
 
 static void
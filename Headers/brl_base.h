@@ -115,6 +115,36 @@ extern size_t readBraillePacket (
   BraillePacketVerifier *verifyPacket, void *data
 );
 
+typedef enum {
+  BRL_PKT_CHECKSUM_NONE = 0,
+  BRL_PKT_CHECKSUM_SUM,
+  BRL_PKT_CHECKSUM_XOR
+} BraillePacketChecksum;
+
+typedef struct {
+  unsigned char length;
+  unsigned char lengthOffset;
+  unsigned char lengthWidth;
+  unsigned char lengthIsBigEndian:1;
+
+  unsigned char hasTerminator:1;
+  unsigned char terminator;
+
+  BraillePacketChecksum checksum;
+} BraillePacketFormat;
+
+typedef struct {
+  const BraillePacketFormat *defaultFormat;
+  const BraillePacketFormat *formats[0X100];
+} BraillePacketGrammar;
+
+extern size_t readFramedBraillePacket (
+  BrailleDisplay *brl,
+  GioEndpoint *endpoint,
+  void *packet, size_t size,
+  const BraillePacketGrammar *grammar
+);
+
 extern int writeBraillePacket (
   BrailleDisplay *brl, GioEndpoint *endpoint,
   const void *packet, size_t size
@@ -34,11 +34,30 @@ extern int cellsHaveChanged (
   unsigned int *from, unsigned int *to, unsigned char *force
 );
 
+#define BRL_CELL_RANGE_LIMIT 4
+
+typedef struct {
+  unsigned int from;
+  unsigned int to;
+} BrailleCellRange;
+
+extern unsigned int cellRangesHaveChanged (
+  unsigned char *cells, const unsigned char *new, unsigned int count,
+  BrailleCellRange *ranges, unsigned int limit,
+  unsigned int overhead, unsigned char *force
+);
+
 extern int textHasChanged (
   wchar_t *text, const wchar_t *new, unsigned int count,
   unsigned int *from, unsigned int *to, unsigned char *force
 );
 
+extern unsigned int textRangesHaveChanged (
+  wchar_t *text, const wchar_t *new, unsigned int count,
+  BrailleCellRange *ranges, unsigned int limit,
+  unsigned int overhead, unsigned char *force
+);
+
 extern int cursorHasChanged (int *cursor, int new, unsigned char *force);
 
 extern unsigned char toLowerDigit (unsigned char upper);
@@ -38,6 +38,18 @@ extern void contractText (
   int *offsetsMap, /* Array of offsets of translated chars in source */
   int cursorOffset /* Position of coursor in source */
 );
+extern void clearContractionCache (ContractionTable *table);
+
+typedef void ContractionResponseHandler (void);
+extern int enableAsynchronousContraction (ContractionTable *table, ContractionResponseHandler *handler);
+extern int isAsynchronousContraction (ContractionTable *table);
+extern int isContractionProvisional (ContractionTable *table);
+extern int awaitContraction (ContractionTable *table);
+extern int prefetchContraction (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int inputLength,
+  int outputLength, int cursorOffset
+);
 
 extern char *ensureContractionTableExtension (const char *path);
 extern char *makeContractionTablePath (const char *directory, const char *name);
@@ -32,6 +32,9 @@ extern int setTableDataVariables (const char *tableExtension, const char *subtab
 
 extern FILE *openDataFile (const char *path, const char *mode, int optional);
 
+typedef void DataFileOpenedHandler (const char *path, void *data);
+extern void setDataFileOpenedHandler (DataFileOpenedHandler *handler, void *data);
+
 typedef struct DataFileStruct DataFile;
 
 #define DATA_OPERANDS_PROCESSOR(name) int name (DataFile *file, void *data)
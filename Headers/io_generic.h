@@ -29,6 +29,9 @@ extern "C" {
 extern void gioInitializeDescriptor (GioDescriptor *descriptor);
 extern void gioInitializeSerialParameters (SerialParameters *parameters);
 
+extern int gioOpenCaptureFile (const char *path);
+extern void gioCloseCaptureFile (void);
+
 extern GioEndpoint *gioConnectResource (
   const char *identifier,
   const GioDescriptor *descriptor
@@ -43,6 +46,7 @@ extern ssize_t gioWriteData (GioEndpoint *endpoint, const void *data, size_t siz
 extern int gioAwaitInput (GioEndpoint *endpoint, int timeout);
 extern ssize_t gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait);
 extern int gioReadByte (GioEndpoint *endpoint, unsigned char *byte, int wait);
+extern int gioUnreadData (GioEndpoint *endpoint, const void *data, size_t size);
 extern int gioDiscardInput (GioEndpoint *endpoint);
 
 extern int gioReconfigureResource (
@@ -122,7 +126,8 @@ typedef enum {
   GIO_RESOURCE_NULL,
   GIO_RESOURCE_SERIAL,
   GIO_RESOURCE_USB,
-  GIO_RESOURCE_BLUETOOTH
+  GIO_RESOURCE_BLUETOOTH,
+  GIO_RESOURCE_REPLAY
 } GioResourceType;
 
 extern GioResourceType gioGetResourceType (GioEndpoint *endpoint);
@@ -97,6 +97,7 @@ extern unsigned char logCategoryFlags[LOG_CATEGORY_COUNT];
 
 extern void openLogFile (const char *path);
 extern void closeLogFile (void);
+extern int bufferLogFile (void);
 
 extern void openSystemLog (void);
 extern void closeSystemLog (void);
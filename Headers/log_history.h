@@ -40,7 +40,14 @@ extern unsigned int getLogEntryCount (const LogEntry *entry);
 extern int pushLogEntry (LogEntry **head, const char *text, LogEntryPushOptions options);
 extern int popLogEntry (LogEntry **head);
 
-extern const LogEntry *getNewestLogMessage (int freeze);
+extern unsigned int getOldestLogMessageNumber (void);
+extern unsigned int getNewestLogMessageNumber (int freeze);
+
+extern int getLogMessage (
+  unsigned int number, char *text, size_t size,
+  TimeValue *time, unsigned int *count
+);
+
 extern void pushLogMessage (const char *message);
 
 #ifdef __cplusplus
@@ -35,6 +35,7 @@ extern Menu *newMenu (void);
 extern void destroyMenu (Menu *menu);
 
 extern MenuItem *newTextMenuItem (Menu *menu, const MenuString *name, const char *text);
+extern void deleteMenuItems (Menu *menu, unsigned int index, unsigned int count);
 
 extern MenuItem *newNumericMenuItem (
   Menu *menu, unsigned char *setting, const MenuString *name,
@@ -0,0 +1,241 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2017 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://brltty.com/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_SCR_SHM
+#define BRLTTY_INCLUDED_SCR_SHM
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Version 2 of the shared screen image.
+ *
+ * The original layout is four bytes (columns, rows, cursor column, cursor
+ * row) followed by byte-sized text and attributes and then two bytes of
+ * auxiliary data (window number, flags). It can't describe a screen wider
+ * or taller than 255 cells, can't hold characters outside the writer's
+ * locale, and a reader can't tell when it has caught the writer part way
+ * through an update.
+ *
+ * A version 2 segment starts with the header below. Its first byte is
+ * always zero, which the original layout never has because that byte is
+ * its column count, so a reader can support both. The text plane holds one
+ * UCS-4 character per cell and the attributes plane one byte per cell, both
+ * in row-major order. The row generation array records, for each row, the
+ * generation of the update which last changed it. A reader which remembers
+ * the generation it last copied only needs to copy the rows with a later
+ * one. Readers never write to the segment, so any number of them can share
+ * it.
+ *
+ * Updates are bracketed by a sequence counter (a seqlock): it's odd while
+ * an update is in progress and is incremented again when the update is
+ * complete. A reader which sees an odd value, or a different value after
+ * copying than before, has caught a partial update and should try again.
+ */
+
+#define SCREEN_SEGMENT_MAGIC_0 0X00
+#define SCREEN_SEGMENT_MAGIC_1 'B'
+#define SCREEN_SEGMENT_MAGIC_2 'S'
+#define SCREEN_SEGMENT_MAGIC_3 'I'
+#define SCREEN_SEGMENT_VERSION 2
+
+#define SCREEN_SEGMENT_FLAG_APPLICATION_CURSOR_KEYS 0X01
+
+typedef struct {
+  unsigned char magic[4];
+  uint16_t version;
+  uint16_t headerSize;
+  uint32_t segmentSize;
+
+  volatile uint32_t sequence;
+  uint32_t generation;
+
+  uint16_t rows;
+  uint16_t columns;
+  uint16_t cursorRow;
+  uint16_t cursorColumn;
+  uint16_t number;
+  uint16_t flags;
+
+  uint32_t cellLimit;
+  uint32_t rowLimit;
+
+  uint32_t textOffset;
+  uint32_t attributesOffset;
+  uint32_t rowGenerationsOffset;
+} ScreenSegmentHeader;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SCREEN_SEGMENT_BARRIER() __sync_synchronize()
+#else /* memory barrier */
+#define SCREEN_SEGMENT_BARRIER()
+#endif /* memory barrier */
+
+static inline int
+isScreenSegment (const void *address, size_t size) {
+  const ScreenSegmentHeader *header = address;
+
+  if (size < sizeof(*header)) return 0;
+  if (header->magic[0] != SCREEN_SEGMENT_MAGIC_0) return 0;
+  if (header->magic[1] != SCREEN_SEGMENT_MAGIC_1) return 0;
+  if (header->magic[2] != SCREEN_SEGMENT_MAGIC_2) return 0;
+  if (header->magic[3] != SCREEN_SEGMENT_MAGIC_3) return 0;
+  if (header->version != SCREEN_SEGMENT_VERSION) return 0;
+  if (header->segmentSize > size) return 0;
+
+  if (header->textOffset + (header->cellLimit * sizeof(uint32_t)) > header->segmentSize) return 0;
+  if (header->attributesOffset + header->cellLimit > header->segmentSize) return 0;
+  if (header->rowGenerationsOffset + (header->rowLimit * sizeof(uint32_t)) > header->segmentSize) return 0;
+  return 1;
+}
+
+static inline uint32_t *
+getScreenSegmentText (const ScreenSegmentHeader *header) {
+  return (uint32_t *)((unsigned char *)header + header->textOffset);
+}
+
+static inline unsigned char *
+getScreenSegmentAttributes (const ScreenSegmentHeader *header) {
+  return (unsigned char *)header + header->attributesOffset;
+}
+
+static inline uint32_t *
+getScreenSegmentRowGenerations (const ScreenSegmentHeader *header) {
+  return (uint32_t *)((unsigned char *)header + header->rowGenerationsOffset);
+}
+
+/* The writer's side of the protocol. This header is self-contained so that
+ * a writer (e.g. a terminal multiplexer) can include it without the rest of
+ * BRLTTY. A writer creates a segment of getScreenSegmentSize() bytes
+ * (shmget() or shm_open() with the same key or name as the original
+ * layout), calls initializeScreenSegment() once, and then makes each change
+ * between beginScreenSegmentUpdate() and endScreenSegmentUpdate(). There
+ * must only be one writer. See Programs/scrshmtest.c for an example.
+ */
+
+static inline size_t
+getScreenSegmentSize (unsigned int rowLimit, unsigned int columnLimit) {
+  size_t cellLimit = rowLimit * columnLimit;
+
+  return sizeof(ScreenSegmentHeader)
+       + (cellLimit * sizeof(uint32_t))
+       + (rowLimit * sizeof(uint32_t))
+       + cellLimit;
+}
+
+static inline void
+initializeScreenSegment (void *address, unsigned int rowLimit, unsigned int columnLimit) {
+  ScreenSegmentHeader *header = address;
+  size_t cellLimit = rowLimit * columnLimit;
+
+  memset(header, 0, getScreenSegmentSize(rowLimit, columnLimit));
+  header->version = SCREEN_SEGMENT_VERSION;
+  header->headerSize = sizeof(*header);
+  header->segmentSize = getScreenSegmentSize(rowLimit, columnLimit);
+
+  header->cellLimit = cellLimit;
+  header->rowLimit = rowLimit;
+
+  header->textOffset = sizeof(*header);
+  header->rowGenerationsOffset = header->textOffset + (cellLimit * sizeof(uint32_t));
+  header->attributesOffset = header->rowGenerationsOffset + (rowLimit * sizeof(uint32_t));
+
+  /* The magic number is set last so that a reader never accepts a
+   * partially initialized segment.
+   */
+  SCREEN_SEGMENT_BARRIER();
+  header->magic[0] = SCREEN_SEGMENT_MAGIC_0;
+  header->magic[1] = SCREEN_SEGMENT_MAGIC_1;
+  header->magic[2] = SCREEN_SEGMENT_MAGIC_2;
+  header->magic[3] = SCREEN_SEGMENT_MAGIC_3;
+}
+
+static inline void
+beginScreenSegmentUpdate (ScreenSegmentHeader *header) {
+  header->sequence += 1;
+  SCREEN_SEGMENT_BARRIER();
+}
+
+static inline void
+endScreenSegmentUpdate (ScreenSegmentHeader *header) {
+  SCREEN_SEGMENT_BARRIER();
+  header->generation += 1;
+  SCREEN_SEGMENT_BARRIER();
+  header->sequence += 1;
+}
+
+static inline void
+markScreenSegmentRows (ScreenSegmentHeader *header, unsigned int row, unsigned int count) {
+  uint32_t *generations = getScreenSegmentRowGenerations(header);
+
+  while (count-- > 0) generations[row++] = header->generation + 1;
+}
+
+static inline int
+setScreenSegmentSize (ScreenSegmentHeader *header, unsigned int rows, unsigned int columns) {
+  if (rows > header->rowLimit) return 0;
+  if ((rows * columns) > header->cellLimit) return 0;
+
+  if ((rows != header->rows) || (columns != header->columns)) {
+    header->rows = rows;
+    header->columns = columns;
+    markScreenSegmentRows(header, 0, rows);
+  }
+
+  return 1;
+}
+
+static inline void
+setScreenSegmentCursor (ScreenSegmentHeader *header, unsigned int row, unsigned int column) {
+  header->cursorRow = row;
+  header->cursorColumn = column;
+}
+
+static inline void
+setScreenSegmentWindow (ScreenSegmentHeader *header, unsigned int number, unsigned int flags) {
+  header->number = number;
+  header->flags = flags;
+}
+
+static inline void
+setScreenSegmentRow (
+  ScreenSegmentHeader *header, unsigned int row,
+  const uint32_t *text, const unsigned char *attributes
+) {
+  if (row < header->rows) {
+    size_t offset = row * header->columns;
+    uint32_t *toText = getScreenSegmentText(header) + offset;
+    unsigned char *toAttributes = getScreenSegmentAttributes(header) + offset;
+
+    if ((memcmp(toText, text, (header->columns * sizeof(*text))) != 0) ||
+        (memcmp(toAttributes, attributes, header->columns) != 0)) {
+      memcpy(toText, text, (header->columns * sizeof(*text)));
+      memcpy(toAttributes, attributes, header->columns);
+      markScreenSegmentRows(header, row, 1);
+    }
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_SCR_SHM */
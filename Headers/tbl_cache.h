@@ -16,15 +16,23 @@
  * This software is maintained by Dave Mielke <dave@mielke.cc>.
  */
 
-#ifndef BRLTTY_INCLUDED_SCR_SHM
-#define BRLTTY_INCLUDED_SCR_SHM
+#ifndef BRLTTY_INCLUDED_TBL_CACHE
+#define BRLTTY_INCLUDED_TBL_CACHE
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
+typedef struct TableCacheMappingStruct TableCacheMapping;
+extern const void *mapCachedTable (const char *type, const char *path, size_t *size, TableCacheMapping **mapping);
+extern void unmapCachedTable (TableCacheMapping *mapping);
+
+typedef struct TableCacheRecorderStruct TableCacheRecorder;
+extern TableCacheRecorder *startTableCacheRecorder (const char *type, const char *path);
+extern void stopTableCacheRecorder (TableCacheRecorder *recorder, const void *data, size_t size);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
 
-#endif /* BRLTTY_INCLUDED_SCR_SHM */
+#endif /* BRLTTY_INCLUDED_TBL_CACHE */
@@ -20,6 +20,7 @@
 
 #include <string.h>
 
+#include "log.h"
 #include "file.h"
 #include "datafile.h"
 #include "dataarea.h"
@@ -161,11 +162,38 @@ static DATA_OPERANDS_PROCESSOR(processAttributesTableOperands) {
   return processDirectiveOperand(file, &directives, "attributes table directive", data);
 }
 
+static AttributesTable *
+loadCachedAttributesTable (const char *name) {
+  TableCacheMapping *mapping;
+  size_t size;
+  const void *bytes = mapCachedTable("atb", name, &size, &mapping);
+
+  if (bytes) {
+    AttributesTable *table = malloc(sizeof(*table));
+
+    if (table) {
+      table->header.bytes = bytes;
+      table->size = size;
+      table->mapping = mapping;
+      return table;
+    } else {
+      logMallocError();
+    }
+
+    unmapCachedTable(mapping);
+  }
+
+  return NULL;
+}
+
 AttributesTable *
 compileAttributesTable (const char *name) {
-  AttributesTable *table = NULL;
+  AttributesTable *table;
+
+  if ((table = loadCachedAttributesTable(name))) return table;
 
   if (setTableDataVariables(ATTRIBUTES_TABLE_EXTENSION, ATTRIBUTES_SUBTABLE_EXTENSION)) {
+    TableCacheRecorder *recorder = startTableCacheRecorder("atb", name);
     AttributesTableData atd;
     memset(&atd, 0, sizeof(atd));
 
@@ -181,6 +209,7 @@ compileAttributesTable (const char *name) {
             if ((table = malloc(sizeof(*table)))) {
               table->header.fields = getAttributesTableHeader(&atd);
               table->size = getDataSize(atd.area);
+              table->mapping = NULL;
               resetDataArea(atd.area);
             }
           }
@@ -189,6 +218,14 @@ compileAttributesTable (const char *name) {
 
       destroyDataArea(atd.area);
     }
+
+    if (recorder) {
+      if (table) {
+        stopTableCacheRecorder(recorder, table->header.bytes, table->size);
+      } else {
+        stopTableCacheRecorder(recorder, NULL, 0);
+      }
+    }
   }
 
   return table;
@@ -197,7 +234,12 @@ compileAttributesTable (const char *name) {
 void
 destroyAttributesTable (AttributesTable *table) {
   if (table->size) {
-    free(table->header.fields);
+    if (table->mapping) {
+      unmapCachedTable(table->mapping);
+    } else {
+      free(table->header.fields);
+    }
+
     free(table);
   }
 }
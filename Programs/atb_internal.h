@@ -19,6 +19,8 @@
 #ifndef BRLTTY_INCLUDED_ATB_INTERNAL
 #define BRLTTY_INCLUDED_ATB_INTERNAL
 
+#include "tbl_cache.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -36,6 +38,7 @@ struct AttributesTableStruct {
   } header;
 
   size_t size;
+  TableCacheMapping *mapping;
 };
 
 #ifdef __cplusplus
@@ -18,11 +18,13 @@
 
 #include "prologue.h"
 
+#include <stdio.h>
 #include <string.h>
 #include <errno.h>
 
 #include "log.h"
 #include "parameters.h"
+#include "file.h"
 #include "timing.h"
 #include "async_wait.h"
 #include "parse.h"
@@ -64,6 +66,9 @@ typedef struct {
   uint64_t bda;
   int connectError;
   char *deviceName;
+
+  uint8_t channel;
+  int32_t cacheTime;
 } BluetoothDeviceEntry;
 
 static void
@@ -79,12 +84,28 @@ bthCreateDeviceQueue (void *data) {
   return newQueue(bthDeallocateDeviceEntry, NULL);
 }
 
+static int bthDeviceCacheLoaded = 0;
+static void bthLoadDeviceCache (Queue *devices);
+
 static Queue *
 bthGetDeviceQueue (int create) {
   static Queue *devices = NULL;
+  Queue *queue;
+
+  /* The queue always needs to exist once the cache has been looked at,
+   * even if nothing else would have created it yet.
+   */
+  if (!bthDeviceCacheLoaded) create = 1;
 
-  return getProgramQueue(&devices, "bluetooth-device-queue", create,
-                         bthCreateDeviceQueue, NULL);
+  queue = getProgramQueue(&devices, "bluetooth-device-queue", create,
+                                 bthCreateDeviceQueue, NULL);
+
+  if (queue && !bthDeviceCacheLoaded) {
+    bthDeviceCacheLoaded = 1;
+    bthLoadDeviceCache(queue);
+  }
+
+  return queue;
 }
 
 static int
@@ -95,6 +116,27 @@ bthTestDeviceEntry (const void *item, void *data) {
   return entry->bda == *bda;
 }
 
+static BluetoothDeviceEntry *
+bthAddDeviceEntry (Queue *devices, uint64_t bda) {
+  BluetoothDeviceEntry *entry;
+
+  if ((entry = malloc(sizeof(*entry)))) {
+    entry->bda = bda;
+    entry->connectError = 0;
+    entry->deviceName = NULL;
+
+    entry->channel = 0;
+    entry->cacheTime = 0;
+
+    if (enqueueItem(devices, entry)) return entry;
+    free(entry);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
 static BluetoothDeviceEntry *
 bthGetDeviceEntry (uint64_t bda, int add) {
   Queue *devices = bthGetDeviceQueue(add);
@@ -102,29 +144,200 @@ bthGetDeviceEntry (uint64_t bda, int add) {
   if (devices) {
     BluetoothDeviceEntry *entry = findItem(devices, bthTestDeviceEntry, &bda);
     if (entry) return entry;
+    if (add) return bthAddDeviceEntry(devices, bda);
+  }
 
-    if (add) {
-      if ((entry = malloc(sizeof(*entry)))) {
-        entry->bda = bda;
-        entry->connectError = 0;
-        entry->deviceName = NULL;
+  return NULL;
+}
 
-        if (enqueueItem(devices, entry)) return entry;
-        free(entry);
-      } else {
-        logMallocError();
+static char *
+bthMakeDeviceCachePath (void) {
+  return makeUpdatablePath(BLUETOOTH_DEVICE_CACHE_FILE);
+}
+
+static void
+bthLoadDeviceCache (Queue *devices) {
+  char *path = bthMakeDeviceCachePath();
+
+  if (path) {
+    FILE *stream = openFile(path, "r", 1);
+
+    if (stream) {
+      char *line = NULL;
+      size_t size = 0;
+      TimeValue now;
+
+      getCurrentTime(&now);
+
+      while (readLine(stream, &line, &size)) {
+        char address[0X20];
+        long int time;
+        unsigned int channel;
+        int offset;
+
+        if (sscanf(line, "%31s %ld %u%n", address, &time, &channel, &offset) == 3) {
+          uint64_t bda;
+
+          if ((now.seconds - time) > BLUETOOTH_DEVICE_CACHE_LIFETIME) continue;
+          if (channel > UINT8_MAX) continue;
+
+          if (bthParseAddress(&bda, address)) {
+            if (!findItem(devices, bthTestDeviceEntry, &bda)) {
+              BluetoothDeviceEntry *entry = bthAddDeviceEntry(devices, bda);
+
+              if (entry) {
+                const char *name = line + offset;
+
+                /* The name is separated by exactly one space, and any spaces
+                 * after that are part of it.
+                 */
+                if (*name == ' ') name += 1;
+
+                entry->channel = channel;
+                entry->cacheTime = time;
+
+                if (*name) {
+                  if (!(entry->deviceName = strdup(name))) {
+                    logMallocError();
+                  }
+                }
+
+                logMessage(LOG_CATEGORY(BLUETOOTH_IO),
+                           "cached device: %s: channel=%u name=%s",
+                           address, entry->channel, name);
+              }
+            }
+          }
+        }
+      }
+
+      if (line) free(line);
+      fclose(stream);
+    }
+
+    free(path);
+  }
+}
+
+static int
+bthWriteDeviceCacheEntry (void *item, void *data) {
+  const BluetoothDeviceEntry *entry = item;
+  FILE *stream = data;
+
+  if (entry->cacheTime) {
+    if (entry->channel || entry->deviceName) {
+      uint64_t bda = entry->bda;
+      char address[BDA_SIZE * 3];
+      char *byte = &address[sizeof(address)];
+
+      *--byte = 0;
+
+      while (1) {
+        static const char digits[] = "0123456789ABCDEF";
+
+        *--byte = digits[bda & 0XF];
+        bda >>= 4;
+        *--byte = digits[bda & 0XF];
+        bda >>= 4;
+
+        if (byte == address) break;
+        *--byte = ':';
       }
+
+      fprintf(stream, "%s %ld %u %s\n",
+              address, (long int)entry->cacheTime, entry->channel,
+              (entry->deviceName? entry->deviceName: ""));
     }
   }
 
-  return NULL;
+  return 0;
+}
+
+static void
+bthSaveDeviceCache (void) {
+  Queue *devices = bthGetDeviceQueue(0);
+
+  if (devices) {
+    char *path = bthMakeDeviceCachePath();
+
+    if (path) {
+      char temporaryPath[strlen(path) + 0X20];
+      FILE *stream;
+
+      /* Write a new file and then rename it so that another process never
+       * sees a partially written cache.
+       */
+      snprintf(temporaryPath, sizeof(temporaryPath), "%s.%ld.new", path, (long int)getpid());
+
+      if ((stream = openFile(temporaryPath, "w", 0))) {
+        int ok = 1;
+
+        processQueue(devices, bthWriteDeviceCacheEntry, stream);
+        if (ferror(stream)) ok = 0;
+
+        if (fclose(stream) == EOF) {
+          logSystemError("fclose");
+          ok = 0;
+        }
+
+        if (ok) {
+          if (rename(temporaryPath, path) == -1) {
+            logSystemError("rename");
+            ok = 0;
+          }
+        }
+
+        if (!ok) unlink(temporaryPath);
+      }
+
+      free(path);
+    }
+  }
+}
+
+static void
+bthUpdateDeviceCache (BluetoothDeviceEntry *entry) {
+  TimeValue now;
+
+  getCurrentTime(&now);
+  entry->cacheTime = now.seconds;
+  bthSaveDeviceCache();
+}
+
+static int
+bthRecallChannel (uint64_t bda, uint8_t *channel) {
+  BluetoothDeviceEntry *entry = bthGetDeviceEntry(bda, 0);
+  if (!entry) return 0;
+  if (!entry->channel) return 0;
+
+  *channel = entry->channel;
+  return 1;
+}
+
+static void
+bthRememberChannel (uint64_t bda, uint8_t channel) {
+  BluetoothDeviceEntry *entry = bthGetDeviceEntry(bda, 1);
+
+  if (entry) {
+    if (entry->channel != channel) {
+      entry->channel = channel;
+      bthUpdateDeviceCache(entry);
+    }
+  }
 }
 
 void
 bthForgetDevices (void) {
   Queue *devices = bthGetDeviceQueue(0);
 
-  if (devices) deleteElements(devices);
+  if (devices) {
+    deleteElements(devices);
+
+    /* Only the in-memory entries are forgotten - the persistent cache is
+     * reloaded the next time a device is looked up.
+     */
+    bthDeviceCacheLoaded = 0;
+  }
 }
 
 static int
@@ -146,6 +359,21 @@ bthRecallConnectError (uint64_t bda, int *value) {
   return 1;
 }
 
+static int
+bthConnectChannel (BluetoothConnection *connection, int timeout) {
+  TimePeriod period;
+  startTimePeriod(&period, BLUETOOTH_CHANNEL_BUSY_RETRY_TIMEOUT);
+
+  while (1) {
+    if (bthOpenChannel(connection->extension, connection->channel, timeout)) return 1;
+    if (afterTimePeriod(&period, NULL)) break;
+    if (errno != EBUSY) break;
+    asyncWait(BLUETOOTH_CHANNEL_BUSY_RETRY_INTERVAL);
+  }
+
+  return 0;
+}
+
 static BluetoothConnection *
 bthNewConnection (const char *address, uint8_t channel, int discover, int timeout) {
   BluetoothConnection *connection;
@@ -157,8 +385,17 @@ bthNewConnection (const char *address, uint8_t channel, int discover, int timeou
     if (bthParseAddress(&connection->address, address)) {
       if ((connection->extension = bthNewConnectionExtension(connection->address))) {
         int alreadyTried = 0;
+        int cachedChannel = 0;
+
+        if (discover) {
+          if (bthRecallChannel(connection->address, &connection->channel)) {
+            logMessage(LOG_CATEGORY(BLUETOOTH_IO), "using cached serial port channel");
+            cachedChannel = 1;
+          } else {
+            bthDiscoverSerialPortChannel(&connection->channel, connection->extension, timeout);
+          }
+        }
 
-        if (discover) bthDiscoverSerialPortChannel(&connection->channel, connection->extension, timeout);
         bthLogChannel(connection->channel);
 
         {
@@ -171,20 +408,31 @@ bthNewConnection (const char *address, uint8_t channel, int discover, int timeou
         }
 
         if (!alreadyTried) {
-          TimePeriod period;
-          startTimePeriod(&period, BLUETOOTH_CHANNEL_BUSY_RETRY_TIMEOUT);
+          if (bthConnectChannel(connection, timeout)) {
+            if (discover) bthRememberChannel(connection->address, connection->channel);
+            return connection;
+          }
 
-          while (1) {
-            if (bthOpenChannel(connection->extension, connection->channel, timeout)) {
-              return connection;
-            }
+          if (cachedChannel) {
+            logMessage(LOG_CATEGORY(BLUETOOTH_IO), "cached serial port channel not usable");
+            bthRememberChannel(connection->address, 0);
+
+            if (bthDiscoverSerialPortChannel(&connection->channel, connection->extension, timeout)) {
+              bthLogChannel(connection->channel);
 
-            if (afterTimePeriod(&period, NULL)) break;
-            if (errno != EBUSY) break;
-            asyncWait(BLUETOOTH_CHANNEL_BUSY_RETRY_INTERVAL);
+              if (bthConnectChannel(connection, timeout)) {
+                bthRememberChannel(connection->address, connection->channel);
+                return connection;
+              }
+            }
           }
 
-          bthRememberConnectError(connection->address, errno);
+          {
+            int error = errno;
+
+            bthRememberConnectError(connection->address, error);
+            errno = error;
+          }
         }
 
         bthReleaseConnectionExtension(connection->extension);
@@ -403,6 +651,7 @@ bthGetDeviceName (uint64_t bda, int timeout) {
 
       if ((entry->deviceName = bthObtainDeviceName(bda, timeout))) {
         logMessage(LOG_CATEGORY(BLUETOOTH_IO), "device name: %s", entry->deviceName);
+        bthUpdateDeviceCache(entry);
       } else {
         logMessage(LOG_CATEGORY(BLUETOOTH_IO), "device name not obtained");
       }
@@ -270,6 +270,162 @@ readBraillePacket (
   }
 }
 
+static int
+readFramedBytes (GioEndpoint *endpoint, unsigned char *bytes, size_t *count, size_t length) {
+  if (*count < length) {
+    ssize_t result = gioReadData(endpoint, &bytes[*count], length-*count, 1);
+
+    if (result > 0) *count += result;
+
+    if (*count < length) {
+      logPartialPacket(bytes, *count);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* A framing error may have been caused by a stray byte which was mistaken
+ * for the start of a packet. Only that byte is dropped - the rest are
+ * returned to the endpoint so that they're examined again.
+ */
+static void
+resyncFramedBytes (GioEndpoint *endpoint, const unsigned char *bytes, size_t count) {
+  logDiscardedByte(bytes[0]);
+
+  if (--count) {
+    if (!gioUnreadData(endpoint, &bytes[1], count)) {
+      logDiscardedBytes(&bytes[1], count);
+    }
+  }
+}
+
+static int
+verifyFramedChecksum (
+  const BraillePacketFormat *format,
+  const unsigned char *bytes, size_t length
+) {
+  size_t location = length - 1;
+  unsigned char checksum = 0;
+
+  if (format->checksum == BRL_PKT_CHECKSUM_NONE) return 1;
+  if (format->hasTerminator) location -= 1;
+
+  for (size_t index=0; index<length; index+=1) {
+    if (index == location) continue;
+
+    switch (format->checksum) {
+      case BRL_PKT_CHECKSUM_SUM:
+        checksum += bytes[index];
+        break;
+
+      case BRL_PKT_CHECKSUM_XOR:
+        checksum ^= bytes[index];
+        break;
+
+      default:
+        return 1;
+    }
+  }
+
+  return checksum == bytes[location];
+}
+
+size_t
+readFramedBraillePacket (
+  BrailleDisplay *brl,
+  GioEndpoint *endpoint,
+  void *packet, size_t size,
+  const BraillePacketGrammar *grammar
+) {
+  unsigned char *bytes = packet;
+
+  if (!endpoint) endpoint = brl->gioEndpoint;
+
+  while (1) {
+    const BraillePacketFormat *format;
+    size_t length;
+    size_t count = 0;
+
+    if (!gioReadByte(endpoint, &bytes[count], 0)) return 0;
+
+    if (!(format = grammar->formats[bytes[count]])) {
+      if (!(format = grammar->defaultFormat)) {
+        logIgnoredByte(bytes[count]);
+        continue;
+      }
+    }
+
+    count += 1;
+    length = format->length;
+
+    if (format->lengthWidth) {
+      size_t end = format->lengthOffset + format->lengthWidth;
+
+      if (end > size) {
+        logTruncatedPacket(bytes, count);
+        resyncFramedBytes(endpoint, bytes, count);
+        continue;
+      }
+
+      if (!readFramedBytes(endpoint, bytes, &count, end)) return 0;
+
+      {
+        const unsigned char *field = &bytes[format->lengthOffset];
+        size_t value = 0;
+
+        for (unsigned int index=0; index<format->lengthWidth; index+=1) {
+          if (format->lengthIsBigEndian) {
+            value <<= 8;
+            value |= field[index];
+          } else {
+            value |= field[index] << (index * 8);
+          }
+        }
+
+        length += value;
+      }
+    }
+
+    {
+      size_t minimum = 1;
+
+      if (format->hasTerminator) minimum += 1;
+      if (format->checksum != BRL_PKT_CHECKSUM_NONE) minimum += 1;
+
+      if (length < minimum) {
+        logShortPacket(bytes, count);
+        resyncFramedBytes(endpoint, bytes, count);
+        continue;
+      }
+    }
+
+    if (length > size) {
+      logTruncatedPacket(bytes, count);
+      resyncFramedBytes(endpoint, bytes, count);
+      continue;
+    }
+
+    if (!readFramedBytes(endpoint, bytes, &count, length)) return 0;
+
+    if (format->hasTerminator && (bytes[length-1] != format->terminator)) {
+      logCorruptPacket(bytes, length);
+      resyncFramedBytes(endpoint, bytes, length);
+      continue;
+    }
+
+    if (!verifyFramedChecksum(format, bytes, length)) {
+      logInputProblem("incorrect input checksum", bytes, length);
+      resyncFramedBytes(endpoint, bytes, length);
+      continue;
+    }
+
+    logInputPacket(bytes, length);
+    return length;
+  }
+}
+
 int
 writeBraillePacket (
   BrailleDisplay *brl, GioEndpoint *endpoint,
@@ -98,6 +98,73 @@ cellsHaveChanged (
   return 1;
 }
 
+static unsigned int
+findCellDifference (
+  const unsigned char *cells, const unsigned char *new,
+  unsigned int from, unsigned int to
+) {
+  typedef unsigned long int Word;
+
+  while ((to - from) >= sizeof(Word)) {
+    Word oldWord, newWord;
+
+    memcpy(&oldWord, &cells[from], sizeof(oldWord));
+    memcpy(&newWord, &new[from], sizeof(newWord));
+    if (oldWord != newWord) break;
+
+    from += sizeof(Word);
+  }
+
+  while (from < to) {
+    if (cells[from] != new[from]) break;
+    from += 1;
+  }
+
+  return from;
+}
+
+unsigned int
+cellRangesHaveChanged (
+  unsigned char *cells, const unsigned char *new, unsigned int count,
+  BrailleCellRange *ranges, unsigned int limit,
+  unsigned int overhead, unsigned char *force
+) {
+  unsigned int rangeCount = 0;
+
+  if (force && *force) {
+    *force = 0;
+
+    ranges[rangeCount++] = (BrailleCellRange){
+      .from = 0,
+      .to = count
+    };
+
+    memcpy(cells, new, count);
+  } else {
+    unsigned int next = findCellDifference(cells, new, 0, count);
+
+    while (next < count) {
+      BrailleCellRange *range = &ranges[rangeCount++];
+
+      range->from = next;
+
+      /* Unchanged gaps no longer than the cost of starting another write
+       * are cheaper to resend than to skip. Once the caller's array is
+       * full, the last range absorbs every remaining difference.
+       */
+      do {
+        range->to = next + 1;
+        next = findCellDifference(cells, new, range->to, count);
+      } while ((next < count) &&
+               (((next - range->to) <= overhead) || (rangeCount == limit)));
+
+      memcpy(&cells[range->from], &new[range->from], (range->to - range->from));
+    }
+  }
+
+  return rangeCount;
+}
+
 int
 textHasChanged (
   wchar_t *text, const wchar_t *new, unsigned int count,
@@ -133,6 +200,57 @@ textHasChanged (
   return 1;
 }
 
+static unsigned int
+findTextDifference (
+  const wchar_t *text, const wchar_t *new,
+  unsigned int from, unsigned int to
+) {
+  while (from < to) {
+    if (text[from] != new[from]) break;
+    from += 1;
+  }
+
+  return from;
+}
+
+unsigned int
+textRangesHaveChanged (
+  wchar_t *text, const wchar_t *new, unsigned int count,
+  BrailleCellRange *ranges, unsigned int limit,
+  unsigned int overhead, unsigned char *force
+) {
+  unsigned int rangeCount = 0;
+
+  if (force && *force) {
+    *force = 0;
+
+    ranges[rangeCount++] = (BrailleCellRange){
+      .from = 0,
+      .to = count
+    };
+
+    wmemcpy(text, new, count);
+  } else {
+    unsigned int next = findTextDifference(text, new, 0, count);
+
+    while (next < count) {
+      BrailleCellRange *range = &ranges[rangeCount++];
+
+      range->from = next;
+
+      do {
+        range->to = next + 1;
+        next = findTextDifference(text, new, range->to, count);
+      } while ((next < count) &&
+               (((next - range->to) <= overhead) || (rangeCount == limit)));
+
+      wmemcpy(&text[range->from], &new[range->from], (range->to - range->from));
+    }
+  }
+
+  return rangeCount;
+}
+
 int
 cursorHasChanged (int *cursor, int new, unsigned char *force) {
   if (force && *force) {
@@ -608,10 +608,9 @@ getCursorOverlay (BrailleDisplay *brl) {
 static void getDots(const BrailleWindow *brailleWindow, unsigned char *buf)
 {
   int i;
-  unsigned char c;
+  convertCharactersToDots(textTable, brailleWindow->text, buf, displaySize);
   for (i=0; i<displaySize; i++) {
-    c = convertCharacterToDots(textTable, brailleWindow->text[i]);
-    buf[i] = (c & brailleWindow->andAttr[i]) | brailleWindow->orAttr[i];
+    buf[i] = (buf[i] & brailleWindow->andAttr[i]) | brailleWindow->orAttr[i];
   }
 
   if (brailleWindow->cursor) {
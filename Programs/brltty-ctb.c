@@ -34,6 +34,8 @@
 #include "ascii.h"
 #include "ttb.h"
 #include "ctb.h"
+#include "timing.h"
+#include "thread.h"
 
 static char *opt_tablesDirectory;
 static char *opt_contractionTable;
@@ -42,6 +44,9 @@ static char *opt_verificationTable;
 static int opt_reformatText;
 static char *opt_outputWidth;
 static int opt_forceOutput;
+static char *opt_workerCount;
+static int opt_reportStatistics;
+static int opt_checkEdits;
 
 BEGIN_OPTION_TABLE(programOptions)
   { .letter = 'T',
@@ -95,6 +100,26 @@ BEGIN_OPTION_TABLE(programOptions)
     .setting.flag = &opt_forceOutput,
     .description = strtext("Force immediate output.")
   },
+
+  { .letter = 'j',
+    .word = "jobs",
+    .argument = "count",
+    .setting.string = &opt_workerCount,
+    .internal.setting = "",
+    .description = strtext("Contract in batch mode using this many worker threads.")
+  },
+
+  { .letter = 's',
+    .word = "statistics",
+    .setting.flag = &opt_reportStatistics,
+    .description = strtext("Report throughput.")
+  },
+
+  { .letter = 'e',
+    .word = "check-edits",
+    .setting.flag = &opt_checkEdits,
+    .description = strtext("Check that contracting edited lines incrementally gives the same braille as contracting them from the start.")
+  },
 END_OPTION_TABLE
 
 static wchar_t *inputBuffer;
@@ -102,24 +127,49 @@ static size_t inputSize;
 static size_t inputLength;
 
 static FILE *outputStream;
-static unsigned char *outputBuffer;
 static int outputWidth;
 static int outputExtend;
 
 #define VERIFICATION_TABLE_EXTENSION ".cvb"
 #define VERIFICATION_SUBTABLE_EXTENSION ".cvi"
 
+#define BATCH_CHUNK_SIZE 0X10000
+#define BATCH_CHUNKS_PER_WORKER 4
+
 static ContractionTable *contractionTable;
 static char *verificationTablePath;
 static FILE *verificationTableStream;
 
+typedef struct {
+  ContractionTable *table;
+
+  struct {
+    unsigned char *buffer;
+    int width;
+  } cells;
+
+  struct {
+    unsigned char *buffer;
+    size_t size;
+    size_t count;
+  } bytes;
+} ContractionData;
+
+static ContractionData serialContraction;
+
 static int (*processInputCharacters) (const wchar_t *characters, size_t length, void *data);
-static int (*putCell) (unsigned char cell, void *data);
+static int (*putCell) (ContractionData *cd, unsigned char cell);
 
 typedef struct {
   ProgramExitStatus exitStatus;
 } LineProcessingData;
 
+static struct {
+  TimeValue start;
+  unsigned long int characters;
+  unsigned long int bytes;
+} statistics;
+
 static void
 noMemory (void *data) {
   LineProcessingData *lpd = data;
@@ -148,56 +198,103 @@ flushOutputStream (void *data) {
 }
 
 static int
-putCharacter (unsigned char character, void *data) {
-  fputc(character, outputStream);
+writeOutputBytes (const unsigned char *bytes, size_t count, void *data) {
+  if (count) {
+    fwrite(bytes, 1, count, outputStream);
+    statistics.bytes += count;
+  }
+
   return checkOutputStream(data);
 }
 
+static void
+initializeContractionData (ContractionData *cd, ContractionTable *table) {
+  cd->table = table;
+
+  cd->cells.buffer = NULL;
+  cd->cells.width = outputWidth;
+
+  cd->bytes.buffer = NULL;
+  cd->bytes.size = 0;
+  cd->bytes.count = 0;
+}
+
+static void
+destroyContractionData (ContractionData *cd) {
+  if (cd->cells.buffer) free(cd->cells.buffer);
+  if (cd->bytes.buffer) free(cd->bytes.buffer);
+}
+
 static int
-putMappedCharacter (unsigned char cell, void *data) {
-  fputc(convertDotsToCharacter(textTable, cell), outputStream);
-  return checkOutputStream(data);
+putBytes (ContractionData *cd, const void *bytes, size_t count) {
+  size_t newCount = cd->bytes.count + count;
+
+  if (newCount > cd->bytes.size) {
+    size_t newSize = newCount | 0XFFF;
+    unsigned char *newBuffer = realloc(cd->bytes.buffer, newSize);
+
+    if (!newBuffer) {
+      logMallocError();
+      return 0;
+    }
+
+    cd->bytes.buffer = newBuffer;
+    cd->bytes.size = newSize;
+  }
+
+  memcpy(&cd->bytes.buffer[cd->bytes.count], bytes, count);
+  cd->bytes.count = newCount;
+  return 1;
+}
+
+static int
+putCharacter (ContractionData *cd, unsigned char character) {
+  return putBytes(cd, &character, 1);
+}
+
+static int
+putMappedCharacter (ContractionData *cd, unsigned char cell) {
+  return putCharacter(cd, convertDotsToCharacter(textTable, cell));
 }
 
 static int
-putUnicodeBraille (unsigned char cell, void *data) {
+putUnicodeBraille (ContractionData *cd, unsigned char cell) {
   Utf8Buffer utf8;
   size_t utfs = convertWcharToUtf8(cell|UNICODE_BRAILLE_ROW, utf8);
 
-  fprintf(outputStream, "%.*s", (int)utfs, utf8);
-  return checkOutputStream(data);
+  return putBytes(cd, utf8, utfs);
 }
 
 static int
-writeCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
+writeCharacters (ContractionData *cd, const wchar_t *inputLine, size_t inputLength) {
   const wchar_t *inputBuffer = inputLine;
 
   while (inputLength) {
     int inputCount = inputLength;
-    int outputCount = outputWidth;
+    int outputCount = cd->cells.width;
 
-    if (!outputBuffer) {
-      if (!(outputBuffer = malloc(outputWidth))) {
-        noMemory(data);
+    if (!cd->cells.buffer) {
+      if (!(cd->cells.buffer = malloc(cd->cells.width))) {
+        logMallocError();
         return 0;
       }
     }
 
-    contractText(contractionTable,
+    contractText(cd->table,
                  inputBuffer, &inputCount,
-                 outputBuffer, &outputCount,
+                 cd->cells.buffer, &outputCount,
                  NULL, CTB_NO_CURSOR);
 
     if ((inputCount < inputLength) && outputExtend) {
-      free(outputBuffer);
-      outputBuffer = NULL;
-      outputWidth <<= 1;
+      free(cd->cells.buffer);
+      cd->cells.buffer = NULL;
+      cd->cells.width <<= 1;
     } else {
       {
         int index;
 
         for (index=0; index<outputCount; index+=1)
-          if (!putCell(outputBuffer[index], data))
+          if (!putCell(cd, cd->cells.buffer[index]))
             return 0;
       }
 
@@ -205,7 +302,7 @@ writeCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
       inputLength -= inputCount;
 
       if (inputLength)
-        if (!putCharacter('\n', data))
+        if (!putCharacter(cd, '\n'))
           return 0;
     }
   }
@@ -213,14 +310,424 @@ writeCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
   return 1;
 }
 
+#ifdef GOT_PTHREADS
+typedef enum {
+  BOT_TEXT,
+  BOT_CHARACTER
+} BatchOperationType;
+
+typedef struct {
+  BatchOperationType type;
+  wchar_t character;
+  size_t offset;
+  size_t length;
+} BatchOperation;
+
+typedef struct BatchChunkStruct BatchChunk;
+
+struct BatchChunkStruct {
+  BatchChunk *next;
+
+  struct {
+    wchar_t *array;
+    size_t size;
+    size_t count;
+  } characters;
+
+  struct {
+    BatchOperation *array;
+    unsigned int size;
+    unsigned int count;
+  } operations;
+
+  struct {
+    unsigned char *buffer;
+    size_t count;
+  } bytes;
+
+  unsigned isFinished:1;
+  unsigned isContracted:1;
+};
+
+typedef struct {
+  pthread_t thread;
+  ContractionData contraction;
+  unsigned isRunning:1;
+} BatchWorker;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t chunkQueued;
+  pthread_cond_t chunkFinished;
+
+  BatchChunk *first;
+  BatchChunk *last;
+  BatchChunk *next;
+  unsigned int count;
+  unsigned int limit;
+  unsigned stop:1;
+
+  BatchChunk *current;
+
+  struct {
+    BatchWorker *array;
+    unsigned int count;
+  } workers;
+} BatchData;
+
+static BatchData *batch;
+
+static void
+destroyBatchChunk (BatchChunk *chunk) {
+  if (chunk->characters.array) free(chunk->characters.array);
+  if (chunk->operations.array) free(chunk->operations.array);
+  if (chunk->bytes.buffer) free(chunk->bytes.buffer);
+  free(chunk);
+}
+
+static int
+contractBatchChunk (ContractionData *cd, BatchChunk *chunk) {
+  const BatchOperation *operation = chunk->operations.array;
+  const BatchOperation *end = operation + chunk->operations.count;
+
+  cd->bytes.count = 0;
+
+  while (operation < end) {
+    switch (operation->type) {
+      case BOT_TEXT:
+        if (!writeCharacters(cd, &chunk->characters.array[operation->offset], operation->length)) return 0;
+        break;
+
+      case BOT_CHARACTER:
+        if (!putCharacter(cd, operation->character)) return 0;
+        break;
+    }
+
+    operation += 1;
+  }
+
+  chunk->bytes.buffer = cd->bytes.buffer;
+  chunk->bytes.count = cd->bytes.count;
+
+  cd->bytes.buffer = NULL;
+  cd->bytes.size = 0;
+  cd->bytes.count = 0;
+  return 1;
+}
+
+THREAD_FUNCTION(runBatchWorker) {
+  BatchWorker *worker = argument;
+
+  lockMutex(&batch->mutex);
+
+  while (1) {
+    BatchChunk *chunk;
+
+    while (!(chunk = batch->next) && !batch->stop) {
+      pthread_cond_wait(&batch->chunkQueued, &batch->mutex);
+    }
+
+    if (!chunk) break;
+    batch->next = chunk->next;
+    unlockMutex(&batch->mutex);
+
+    {
+      int contracted = contractBatchChunk(&worker->contraction, chunk);
+
+      lockMutex(&batch->mutex);
+      chunk->isContracted = contracted;
+      chunk->isFinished = 1;
+    }
+
+    pthread_cond_broadcast(&batch->chunkFinished);
+  }
+
+  unlockMutex(&batch->mutex);
+  return NULL;
+}
+
+static int
+writeBatchChunks (int all, void *data) {
+  int ok = 1;
+
+  lockMutex(&batch->mutex);
+
+  while (batch->first) {
+    BatchChunk *chunk = batch->first;
+
+    if (!chunk->isFinished) {
+      if (!all && (batch->count <= batch->limit)) break;
+      pthread_cond_wait(&batch->chunkFinished, &batch->mutex);
+      continue;
+    }
+
+    if (!(batch->first = chunk->next)) batch->last = NULL;
+    batch->count -= 1;
+    unlockMutex(&batch->mutex);
+
+    if (ok) {
+      if (!chunk->isContracted) {
+        noMemory(data);
+        ok = 0;
+      } else if (!writeOutputBytes(chunk->bytes.buffer, chunk->bytes.count, data)) {
+        ok = 0;
+      } else if (opt_forceOutput && !flushOutputStream(data)) {
+        ok = 0;
+      }
+    }
+
+    destroyBatchChunk(chunk);
+    lockMutex(&batch->mutex);
+  }
+
+  unlockMutex(&batch->mutex);
+  return ok;
+}
+
+static int
+submitBatchChunk (void *data) {
+  BatchChunk *chunk = batch->current;
+
+  if (chunk) {
+    batch->current = NULL;
+    chunk->next = NULL;
+
+    lockMutex(&batch->mutex);
+
+    if (batch->last) {
+      batch->last->next = chunk;
+    } else {
+      batch->first = chunk;
+    }
+
+    batch->last = chunk;
+    if (!batch->next) batch->next = chunk;
+    batch->count += 1;
+
+    pthread_cond_signal(&batch->chunkQueued);
+    unlockMutex(&batch->mutex);
+  }
+
+  return writeBatchChunks(0, data);
+}
+
+static BatchOperation *
+addBatchOperation (BatchOperationType type, void *data) {
+  BatchChunk *chunk = batch->current;
+
+  if (!chunk) {
+    if (!(chunk = malloc(sizeof(*chunk)))) {
+      noMemory(data);
+      return NULL;
+    }
+
+    memset(chunk, 0, sizeof(*chunk));
+    batch->current = chunk;
+  }
+
+  if (chunk->operations.count == chunk->operations.size) {
+    unsigned int newSize = chunk->operations.size? chunk->operations.size<<1: 0X40;
+    BatchOperation *newArray = realloc(chunk->operations.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      noMemory(data);
+      return NULL;
+    }
+
+    chunk->operations.array = newArray;
+    chunk->operations.size = newSize;
+  }
+
+  {
+    BatchOperation *operation = &chunk->operations.array[chunk->operations.count++];
+
+    operation->type = type;
+    return operation;
+  }
+}
+
+static int
+addBatchCharacters (const wchar_t *characters, size_t count, void *data) {
+  if (count) {
+    BatchOperation *operation = addBatchOperation(BOT_TEXT, data);
+    BatchChunk *chunk = batch->current;
+
+    if (!operation) return 0;
+
+    if ((chunk->characters.count + count) > chunk->characters.size) {
+      size_t newSize = (chunk->characters.count + count) | 0XFFF;
+      wchar_t *newArray = realloc(chunk->characters.array, ARRAY_SIZE(newArray, newSize));
+
+      if (!newArray) {
+        chunk->operations.count -= 1;
+        noMemory(data);
+        return 0;
+      }
+
+      chunk->characters.array = newArray;
+      chunk->characters.size = newSize;
+    }
+
+    operation->offset = chunk->characters.count;
+    operation->length = count;
+
+    wmemcpy(&chunk->characters.array[chunk->characters.count], characters, count);
+    chunk->characters.count += count;
+  }
+
+  return 1;
+}
+
+static int
+addBatchCharacter (wchar_t character, void *data) {
+  BatchOperation *operation = addBatchOperation(BOT_CHARACTER, data);
+
+  if (!operation) return 0;
+  operation->character = character;
+  return 1;
+}
+
+static void
+stopBatchWorkers (void) {
+  lockMutex(&batch->mutex);
+  batch->stop = 1;
+  pthread_cond_broadcast(&batch->chunkQueued);
+  unlockMutex(&batch->mutex);
+
+  for (unsigned int index=0; index<batch->workers.count; index+=1) {
+    BatchWorker *worker = &batch->workers.array[index];
+
+    if (worker->isRunning) pthread_join(worker->thread, NULL);
+    if (worker->contraction.table) destroyContractionTable(worker->contraction.table);
+    destroyContractionData(&worker->contraction);
+  }
+}
+
+static void
+destroyBatch (void) {
+  stopBatchWorkers();
+
+  while (batch->first) {
+    BatchChunk *chunk = batch->first;
+
+    batch->first = chunk->next;
+    destroyBatchChunk(chunk);
+  }
+
+  if (batch->current) destroyBatchChunk(batch->current);
+
+  pthread_cond_destroy(&batch->chunkFinished);
+  pthread_cond_destroy(&batch->chunkQueued);
+  pthread_mutex_destroy(&batch->mutex);
+
+  free(batch->workers.array);
+  free(batch);
+  batch = NULL;
+}
+
+static int
+startBatch (const char *tablePath, unsigned int workers) {
+  if (!(batch = malloc(sizeof(*batch)))) {
+    logMallocError();
+    return 0;
+  }
+
+  memset(batch, 0, sizeof(*batch));
+  batch->limit = workers * BATCH_CHUNKS_PER_WORKER;
+
+  if (!(batch->workers.array = calloc(workers, sizeof(*batch->workers.array)))) {
+    logMallocError();
+    free(batch);
+    batch = NULL;
+    return 0;
+  }
+
+  pthread_mutex_init(&batch->mutex, NULL);
+  pthread_cond_init(&batch->chunkQueued, NULL);
+  pthread_cond_init(&batch->chunkFinished, NULL);
+
+  while (batch->workers.count < workers) {
+    BatchWorker *worker = &batch->workers.array[batch->workers.count++];
+    ContractionTable *table;
+
+    /* Contraction tables hold translation state, so each worker needs its own. */
+    if (!(table = compileContractionTable(tablePath))) goto failed;
+    initializeContractionData(&worker->contraction, table);
+
+    {
+      char name[0X20];
+      snprintf(name, sizeof(name), "contract-%u", batch->workers.count);
+
+      int error = createThread(name, &worker->thread, NULL, runBatchWorker, worker);
+
+      if (error) {
+        logMessage(LOG_ERR, "cannot create thread: %s: %s", name, strerror(error));
+        goto failed;
+      }
+    }
+
+    worker->isRunning = 1;
+  }
+
+  return 1;
+
+failed:
+  destroyBatch();
+  return 0;
+}
+
+static int
+finishBatch (void *data) {
+  int ok = submitBatchChunk(data) && writeBatchChunks(1, data);
+
+  destroyBatch();
+  return ok;
+}
+#endif /* GOT_PTHREADS */
+
+static int
+contractCharacters (const wchar_t *characters, size_t count, void *data) {
+  statistics.characters += count;
+
+#ifdef GOT_PTHREADS
+  if (batch) return addBatchCharacters(characters, count, data);
+#endif /* GOT_PTHREADS */
+
+  {
+    ContractionData *cd = &serialContraction;
+
+    if (!writeCharacters(cd, characters, count)) {
+      noMemory(data);
+      return 0;
+    }
+
+    if (!writeOutputBytes(cd->bytes.buffer, cd->bytes.count, data)) return 0;
+    cd->bytes.count = 0;
+  }
+
+  return 1;
+}
+
+static int
+endCharacters (wchar_t end, void *data) {
+#ifdef GOT_PTHREADS
+  if (batch) return addBatchCharacter(end, data);
+#endif /* GOT_PTHREADS */
+
+  {
+    unsigned char character = end;
+    return writeOutputBytes(&character, 1, data);
+  }
+}
+
 static int
 flushCharacters (wchar_t end, void *data) {
   if (inputLength) {
-    if (!writeCharacters(inputBuffer, inputLength, data)) return 0;
+    if (!contractCharacters(inputBuffer, inputLength, data)) return 0;
     inputLength = 0;
 
     if (end)
-      if (!putCharacter(end, data))
+      if (!endCharacters(end, data))
         return 0;
   }
 
@@ -265,12 +772,12 @@ processCharacters (const wchar_t *characters, size_t count, wchar_t end, void *d
 
     if (end != '\n') {
       if (!flushCharacters(0, data)) return 0;
-      if (!putCharacter(end, data)) return 0;
+      if (!endCharacters(end, data)) return 0;
     }
   } else {
     if (!flushCharacters('\n', data)) return 0;
-    if (!writeCharacters(characters, count, data)) return 0;
-    if (!putCharacter(end, data)) return 0;
+    if (!contractCharacters(characters, count, data)) return 0;
+    if (!endCharacters(end, data)) return 0;
   }
 
   return 1;
@@ -294,6 +801,19 @@ writeContractedBraille (const wchar_t *characters, size_t length, void *data) {
   }
   if (!processCharacters(character, length, '\n', data)) return 0;
 
+#ifdef GOT_PTHREADS
+  if (batch) {
+    /* Only split at paragraph boundaries - a paragraph which is still being
+     * assembled by the reformatter stays in the input buffer until it ends.
+     */
+    if (batch->current && (batch->current->characters.count >= BATCH_CHUNK_SIZE)) {
+      if (!submitBatchChunk(data)) return 0;
+    }
+
+    return 1;
+  }
+#endif /* GOT_PTHREADS */
+
   if (opt_forceOutput)
     if (!flushOutputStream(data))
       return 0;
@@ -301,6 +821,21 @@ writeContractedBraille (const wchar_t *characters, size_t length, void *data) {
   return 1;
 }
 
+static void
+reportStatistics (void) {
+  TimeValue now;
+  long int elapsed;
+
+  getMonotonicTime(&now);
+  elapsed = millisecondsBetween(&statistics.start, &now);
+
+  logMessage(LOG_NOTICE,
+             "%lu characters contracted into %lu bytes in %ld.%03lds (%lu characters per second)",
+             statistics.characters, statistics.bytes,
+             elapsed / MSECS_PER_SEC, elapsed % MSECS_PER_SEC,
+             (unsigned long int)((statistics.characters * (uint64_t)MSECS_PER_SEC) / (elapsed? elapsed: 1)));
+}
+
 static char *
 makeUtf8FromCells (unsigned char *cells, size_t count) {
   char *text = malloc((count * UTF8_LEN_MAX) + 1);
@@ -420,6 +955,108 @@ processVerificationTable (void) {
   return PROG_EXIT_FATAL;
 }
 
+static ContractionTable *referenceTable;
+static unsigned long int editCount;
+static unsigned long int editMismatches;
+
+static void
+checkEdit (const wchar_t *characters, size_t length, int cursor) {
+  int inputCount[2] = {length, length};
+  int outputCount[2] = {outputWidth, outputWidth};
+  unsigned char cells[2][outputWidth];
+  int offsets[2][length];
+
+  contractText(contractionTable,
+               characters, &inputCount[0],
+               cells[0], &outputCount[0],
+               offsets[0], cursor);
+
+  /* The reference table's cache is cleared first so that it contracts the
+   * whole line rather than resuming from a checkpoint.
+   */
+  clearContractionCache(referenceTable);
+  contractText(referenceTable,
+               characters, &inputCount[1],
+               cells[1], &outputCount[1],
+               offsets[1], cursor);
+
+  editCount += 1;
+
+  if ((inputCount[0] != inputCount[1]) ||
+      (outputCount[0] != outputCount[1]) ||
+      (memcmp(cells[0], cells[1], outputCount[0]) != 0) ||
+      (memcmp(offsets[0], offsets[1], ARRAY_SIZE(offsets[0], inputCount[0])) != 0)) {
+    wchar_t text[length + 1];
+    char *expected = makeUtf8FromCells(cells[1], outputCount[1]);
+    char *actual = makeUtf8FromCells(cells[0], outputCount[0]);
+
+    wmemcpy(text, characters, length);
+    text[length] = 0;
+
+    logMessage(LOG_WARNING,
+               "edit mismatch: %" PRIws ": cursor %d: expected %s, got %s",
+               text, cursor,
+               (expected? expected: "?"), (actual? actual: "?"));
+
+    if (expected) free(expected);
+    if (actual) free(actual);
+    editMismatches += 1;
+  }
+}
+
+static void
+checkEdits (const wchar_t *characters, size_t length) {
+  wchar_t buffer[length];
+  size_t index;
+
+  wmemcpy(buffer, characters, length);
+
+  /* type the line */
+  for (index=1; index<=length; index+=1) checkEdit(buffer, index, index-1);
+
+  /* move the cursor along it */
+  for (index=0; index<length; index+=1) checkEdit(buffer, length, index);
+  checkEdit(buffer, length, CTB_NO_CURSOR);
+
+  /* overtype each character, and then put it back */
+  for (index=0; index<length; index+=1) {
+    wchar_t character = buffer[index];
+
+    buffer[index] = iswspace(character)? WC_C('x'): WC_C(' ');
+    checkEdit(buffer, length, index);
+
+    buffer[index] = character;
+    checkEdit(buffer, length, index);
+  }
+
+  /* delete each character, and then put it back */
+  for (index=0; index<length; index+=1) {
+    size_t count = length - 1;
+
+    wmemmove(&buffer[index], &buffer[index+1], (count - index));
+    if (count) checkEdit(buffer, count, ((index < count)? index: CTB_NO_CURSOR));
+
+    wmemcpy(buffer, characters, length);
+    checkEdit(buffer, length, index);
+  }
+}
+
+static int
+checkEditedLine (const wchar_t *characters, size_t length, void *data) {
+  unsigned char expandCurrentWord = prefs.expandCurrentWord;
+
+  if (length) {
+    prefs.expandCurrentWord = 0;
+    checkEdits(characters, length);
+
+    prefs.expandCurrentWord = 1;
+    checkEdits(characters, length);
+  }
+
+  prefs.expandCurrentWord = expandCurrentWord;
+  return 1;
+}
+
 static DATA_OPERANDS_PROCESSOR(processInputLine) {
   DataOperand line;
   getTextRemaining(file, &line);
@@ -429,6 +1066,7 @@ static DATA_OPERANDS_PROCESSOR(processInputLine) {
 int
 main (int argc, char *argv[]) {
   ProgramExitStatus exitStatus = PROG_EXIT_FATAL;
+  int workerCount = 0;
 
   verificationTablePath = NULL;
   verificationTableStream = NULL;
@@ -451,7 +1089,6 @@ main (int argc, char *argv[]) {
   inputLength = 0;
 
   outputStream = stdout;
-  outputBuffer = NULL;
 
   if ((outputExtend = !*opt_outputWidth)) {
     outputWidth = 0X80;
@@ -464,6 +1101,20 @@ main (int argc, char *argv[]) {
     }
   }
 
+  if (*opt_workerCount) {
+    static const int minimum = 1;
+
+    if (!validateInteger(&workerCount, opt_workerCount, &minimum, NULL)) {
+      logMessage(LOG_ERR, "%s: %s", "invalid worker count", opt_workerCount);
+      return PROG_EXIT_SYNTAX;
+    }
+
+#ifndef GOT_PTHREADS
+    logMessage(LOG_WARNING, "batch mode not supported");
+    workerCount = 0;
+#endif /* GOT_PTHREADS */
+  }
+
   {
     char *contractionTablePath;
 
@@ -498,6 +1149,14 @@ main (int argc, char *argv[]) {
             } else {
               exitStatus = PROG_EXIT_FATAL;
             }
+          } else if (opt_checkEdits) {
+            if ((referenceTable = compileContractionTable(contractionTablePath))) {
+              processInputCharacters = checkEditedLine;
+              editCount = 0;
+              editMismatches = 0;
+            } else {
+              exitStatus = PROG_EXIT_FATAL;
+            }
           }
         }
 
@@ -517,13 +1176,53 @@ main (int argc, char *argv[]) {
               }
             };
 
-            if ((exitStatus = processInputFiles(argv, argc, &parameters)) == PROG_EXIT_SUCCESS) {
-              if (!(flushCharacters('\n', &lpd) && flushOutputStream(&lpd))) {
-                exitStatus = lpd.exitStatus;
+            initializeContractionData(&serialContraction, contractionTable);
+            getMonotonicTime(&statistics.start);
+
+#ifdef GOT_PTHREADS
+            if (workerCount && (processInputCharacters == writeContractedBraille)) {
+              if (!startBatch(contractionTablePath, workerCount)) {
+                exitStatus = PROG_EXIT_FATAL;
               }
             }
+#endif /* GOT_PTHREADS */
+
+            if (exitStatus == PROG_EXIT_SUCCESS) {
+              if ((exitStatus = processInputFiles(argv, argc, &parameters)) == PROG_EXIT_SUCCESS) {
+                if (!flushCharacters('\n', &lpd)) {
+                  exitStatus = lpd.exitStatus;
+                }
+              }
+
+#ifdef GOT_PTHREADS
+              if (batch) {
+                if (!finishBatch(&lpd)) {
+                  if (exitStatus == PROG_EXIT_SUCCESS) exitStatus = lpd.exitStatus;
+                }
+              }
+#endif /* GOT_PTHREADS */
+
+              if (!flushOutputStream(&lpd)) {
+                if (exitStatus == PROG_EXIT_SUCCESS) exitStatus = lpd.exitStatus;
+              }
+
+              if (opt_reportStatistics && (exitStatus == PROG_EXIT_SUCCESS)) {
+                reportStatistics();
+              }
+
+              if (referenceTable && (exitStatus == PROG_EXIT_SUCCESS)) {
+                logMessage((editMismatches? LOG_ERR: LOG_NOTICE),
+                           "%s: %lu edits checked, %lu mismatches",
+                           opt_contractionTable, editCount, editMismatches);
+
+                if (editMismatches) exitStatus = PROG_EXIT_SEMANTIC;
+              }
+            }
+
+            destroyContractionData(&serialContraction);
           }
 
+          if (referenceTable) destroyContractionTable(referenceTable);
           if (textTable) destroyTextTable(textTable);
         }
 
@@ -549,7 +1248,6 @@ main (int argc, char *argv[]) {
     verificationTablePath = NULL;
   }
 
-  if (outputBuffer) free(outputBuffer);
   if (inputBuffer) free(inputBuffer);
   return exitStatus;
 }
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "program.h"
 #include "options.h"
@@ -90,19 +91,25 @@ static TextTable *outputTable;
 static FILE *outputStream;
 static const char *outputName;
 
-static unsigned char (*toDots) (wchar_t character);
+static void (*toDots) (const wchar_t *characters, unsigned char *cells, size_t count);
 static wchar_t (*toCharacter) (unsigned char dots);
 
-static unsigned char
-toDots_mapped (wchar_t character) {
-  return convertCharacterToDots(inputTable, character);
+static void
+toDots_mapped (const wchar_t *characters, unsigned char *cells, size_t count) {
+  convertCharactersToDots(inputTable, characters, cells, count);
 }
 
-static unsigned char
-toDots_unicode (wchar_t character) {
-  return ((character & UNICODE_ROW_MASK) == UNICODE_BRAILLE_ROW)?
-         character & UNICODE_CELL_MASK:
-         (BRL_DOT_1 | BRL_DOT_2 | BRL_DOT_3 | BRL_DOT_4 | BRL_DOT_5 | BRL_DOT_6 | BRL_DOT_7 | BRL_DOT_8);
+static void
+toDots_unicode (const wchar_t *characters, unsigned char *cells, size_t count) {
+  while (count) {
+    wchar_t character = *characters++;
+
+    *cells++ = ((character & UNICODE_ROW_MASK) == UNICODE_BRAILLE_ROW)?
+               character & UNICODE_CELL_MASK:
+               (BRL_DOT_1 | BRL_DOT_2 | BRL_DOT_3 | BRL_DOT_4 | BRL_DOT_5 | BRL_DOT_6 | BRL_DOT_7 | BRL_DOT_8);
+
+    count -= 1;
+  }
 }
 
 static wchar_t
@@ -115,6 +122,48 @@ toCharacter_unicode (unsigned char dots) {
   return UNICODE_BRAILLE_ROW | dots;
 }
 
+static inline wchar_t
+translateCharacter (wchar_t character, unsigned char dots) {
+  if (!iswcntrl(character)) {
+    if (dots || !iswspace(character)) {
+      if (opt_sixDots) dots &= ~(BRL_DOT_7 | BRL_DOT_8);
+      character = toCharacter(dots);
+    }
+  }
+
+  return character;
+}
+
+static int
+writeCharacters (const wchar_t *characters, size_t count, mbstate_t *state) {
+  char buffer[0X4000];
+  size_t length = 0;
+
+  const wchar_t *character = characters;
+  const wchar_t *end = character + count;
+
+  while (1) {
+    if ((character == end) || ((sizeof(buffer) - length) < MB_LEN_MAX)) {
+      if (length) {
+        fwrite(buffer, 1, length, outputStream);
+        if (ferror(outputStream)) return 0;
+        length = 0;
+      }
+
+      if (character == end) break;
+    }
+
+    {
+      size_t result = wcrtomb(&buffer[length], *character++, state);
+
+      if (result == (size_t)-1) return 0;
+      length += result;
+    }
+  }
+
+  return 1;
+}
+
 static int
 writeCharacter (const wchar_t *character, mbstate_t *state) {
   char bytes[0X1000];
@@ -136,7 +185,7 @@ processStream (FILE *inputStream, const char *inputName) {
   memset(&outputState, 0, sizeof(outputState));
 
   while (!feof(inputStream)) {
-    char inputBuffer[0X1000];
+    char inputBuffer[0X4000];
     size_t inputCount = fread(inputBuffer, 1, sizeof(inputBuffer)-1, inputStream);
 
     if (ferror(inputStream)) goto inputError;
@@ -144,8 +193,14 @@ processStream (FILE *inputStream, const char *inputName) {
     inputBuffer[inputCount] = 0;
 
     {
+      wchar_t characters[inputCount];
+      size_t characterCount = 0;
       char *byte = inputBuffer;
+      int isValid = 1;
 
+      /* Decode the whole block first so that the translation loop and the
+       * output encoding each run over a contiguous array.
+       */
       while (inputCount) {
         wchar_t character;
 
@@ -153,24 +208,37 @@ processStream (FILE *inputStream, const char *inputName) {
           size_t result = mbrtowc(&character, byte, inputCount, &inputState);
 
           if (result == (size_t)-2) break;
-          if (result == (size_t)-1) goto inputError;
+          if (result == (size_t)-1) {
+            isValid = 0;
+            break;
+          }
           if (!result) result = 1;
 
           byte += result;
           inputCount -= result;
         }
 
-        if (!iswcntrl(character)) {
-          unsigned char dots = toDots(character);
+        characters[characterCount++] = character;
+      }
 
-          if (dots || !iswspace(character)) {
-            if (opt_sixDots) dots &= ~(BRL_DOT_7 | BRL_DOT_8);
-            character = toCharacter(dots);
-          }
+      if (characterCount) {
+        unsigned char cells[characterCount];
+
+        toDots(characters, cells, characterCount);
+
+        for (size_t index=0; index<characterCount; index+=1) {
+          characters[index] = translateCharacter(characters[index], cells[index]);
         }
+      }
+
+      {
+        int error = errno;
 
-        if (!writeCharacter(&character, &outputState)) goto outputError;
+        if (!writeCharacters(characters, characterCount, &outputState)) goto outputError;
+        errno = error;
       }
+
+      if (!isValid) goto inputError;
     }
   }
 
@@ -25,8 +25,9 @@
 #include "cmd_queue.h"
 #include "cmd_enqueue.h"
 #include "brl_cmds.h"
-#include "queue.h"
+#include "parameters.h"
 #include "async_alarm.h"
+#include "timing.h"
 #include "prefs.h"
 #include "ktb_types.h"
 #include "scr.h"
@@ -149,40 +150,43 @@ handleCommand (int command) {
   return 0;
 }
 
-typedef struct {
-  int command;
-} CommandQueueItem;
-
-static void
-deallocateCommandQueueItem (void *item, void *data) {
-  CommandQueueItem *cmd = item;
-
-  free(cmd);
-}
-
-static Queue *
-createCommandQueue (void *data) {
-  return newQueue(deallocateCommandQueueItem, NULL);
-}
-
-static Queue *
-getCommandQueue (int create) {
-  static Queue *commands = NULL;
-
-  return getProgramQueue(&commands, "command-queue", create,
-                         createCommandQueue, NULL);
-}
+static struct {
+  unsigned int first;
+  unsigned int count;
+  int commands[COMMAND_QUEUE_SIZE];
+  TimeValue times[COMMAND_QUEUE_SIZE];
+
+  struct {
+    unsigned long int commands;
+    unsigned long int total;
+    unsigned long int maximum;
+  } latency;
+} commandQueue = {
+  .first = 0,
+  .count = 0
+};
 
 static int
-dequeueCommand (Queue *queue) {
-  CommandQueueItem *item;
+dequeueCommand (void) {
+  if (commandQueue.count) {
+    int command = commandQueue.commands[commandQueue.first];
 
-  if ((item = dequeueItem(queue))) {
-    int command = item->command;
+    {
+      const TimeValue *queued = &commandQueue.times[commandQueue.first];
+      TimeValue now;
+      unsigned long int latency;
 
-    free(item);
-    item = NULL;
+      getMonotonicTime(&now);
+      latency = ((now.seconds - queued->seconds) * USECS_PER_SEC)
+              + ((now.nanoseconds - queued->nanoseconds) / NSECS_PER_USEC);
 
+      commandQueue.latency.commands += 1;
+      commandQueue.latency.total += latency;
+      if (latency > commandQueue.latency.maximum) commandQueue.latency.maximum = latency;
+    }
+
+    commandQueue.first = (commandQueue.first + 1) % COMMAND_QUEUE_SIZE;
+    commandQueue.count -= 1;
     return command;
   }
 
@@ -193,16 +197,17 @@ static void setCommandAlarm (void *data);
 static AsyncHandle commandAlarm = NULL;
 
 ASYNC_ALARM_CALLBACK(handleCommandAlarm) {
-  Queue *queue = getCommandQueue(0);
-
   asyncDiscardHandle(commandAlarm);
   commandAlarm = NULL;
 
-  if (queue) {
-    int command = dequeueCommand(queue);
+  while (!commandQueueSuspendCount) {
+    CommandEnvironment *env = commandEnvironmentStack;
+    int command;
+
+    if (!env || env->handlingCommand) break;
+    if ((command = dequeueCommand()) == EOF) break;
 
-    if (command != EOF) {
-      CommandEnvironment *env = commandEnvironmentStack;
+    {
       void *state;
       int handled;
 
@@ -223,9 +228,7 @@ setCommandAlarm (void *data) {
     const CommandEnvironment *env = commandEnvironmentStack;
 
     if (env && !env->handlingCommand) {
-      Queue *queue = getCommandQueue(0);
-
-      if (queue && (getQueueSize(queue) > 0)) {
+      if (commandQueue.count > 0) {
         asyncSetAlarmIn(&commandAlarm, 0, handleCommandAlarm, data);
       }
     }
@@ -244,28 +247,20 @@ int
 enqueueCommand (int command) {
   if (command == EOF) return 1;
 
-  {
-    Queue *queue = getCommandQueue(1);
-
-    if (queue) {
-      CommandQueueItem *item = malloc(sizeof(CommandQueueItem));
-
-      if (item) {
-        item->command = command;
+  if (commandQueue.count == COMMAND_QUEUE_SIZE) {
+    logMessage(LOG_WARNING, "command queue full: %04X", command);
+    return 0;
+  }
 
-        if (enqueueItem(queue, item)) {
-          setCommandAlarm(NULL);
-          return 1;
-        }
+  {
+    unsigned int index = (commandQueue.first + commandQueue.count++) % COMMAND_QUEUE_SIZE;
 
-        free(item);
-      } else {
-        logMallocError();
-      }
-    }
+    commandQueue.commands[index] = command;
+    getMonotonicTime(&commandQueue.times[index]);
   }
 
-  return 0;
+  setCommandAlarm(NULL);
+  return 1;
 }
 
 int
@@ -371,12 +366,24 @@ beginCommandQueue (void) {
   commandEnvironmentStack = NULL;
   commandQueueSuspendCount = 0;
 
+  commandQueue.first = 0;
+  commandQueue.count = 0;
+  memset(&commandQueue.latency, 0, sizeof(commandQueue.latency));
+
   return pushCommandEnvironment("initial", NULL, NULL);
 }
 
 void
 endCommandQueue (void) {
   while (popCommandEnvironment());
+
+  if (commandQueue.latency.commands) {
+    logMessage(LOG_LEVEL,
+               "command latency statistics: %lu commands, %lu usecs/command, %lu usecs maximum",
+               commandQueue.latency.commands,
+               commandQueue.latency.total / commandQueue.latency.commands,
+               commandQueue.latency.maximum);
+  }
 }
 
 void
@@ -72,6 +72,7 @@
 #include "prefs.h"
 #include "charset.h"
 
+#include "io_generic.h"
 #include "io_serial.h"
 #include "io_usb.h"
 #include "io_bluetooth.h"
@@ -152,6 +153,8 @@ static int opt_noDaemon;
 static int opt_standardError;
 static char *opt_logLevel;
 static char *opt_logFile;
+static int opt_logBuffer;
+static char *opt_captureFile;
 static int opt_bootParameters = 1;
 static int opt_environmentVariables;
 static char *opt_messageHoldTimeout;
@@ -595,6 +598,21 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("Path to log file.")
   },
 
+  { .letter = 'Z',
+    .word = "log-buffer",
+    .flags = OPT_Hidden | OPT_Config | OPT_Environ,
+    .setting.flag = &opt_logBuffer,
+    .description = strtext("Write log file records from a background thread.")
+  },
+
+  { .letter = 'G',
+    .word = "capture-file",
+    .flags = OPT_Hidden | OPT_Config | OPT_Environ,
+    .argument = strtext("file"),
+    .setting.string = &opt_captureFile,
+    .description = strtext("Path to binary capture file for generic I/O traffic.")
+  },
+
   { .letter = 'v',
     .word = "verify",
     .setting.flag = &opt_verify,
@@ -678,6 +696,11 @@ exitLog (void *data) {
   closeLogFile();
 }
 
+static void
+exitCapture (void *data) {
+  gioCloseCaptureFile();
+}
+
 static void
 setLogLevels (void) {
   systemLogLevel = LOG_NOTICE;
@@ -740,6 +763,12 @@ brlttyPrepare (int argc, char *argv[]) {
   logProgramBanner();
   logProperty(opt_logLevel, "logLevel", gettext("Log Level"));
 
+  if (*opt_captureFile) {
+    if (gioOpenCaptureFile(opt_captureFile)) {
+      onProgramExit("capture", exitCapture, NULL);
+    }
+  }
+
   return PROG_EXIT_SUCCESS;
 }
 
@@ -772,6 +801,11 @@ exitContractionTable (void *data) {
   }
 }
 
+static void
+handleContractionResponse (void) {
+  scheduleUpdate("contraction response");
+}
+
 int
 changeContractionTable (const char *name) {
   ContractionTable *table = NULL;
@@ -782,7 +816,9 @@ changeContractionTable (const char *name) {
     if ((path = makeContractionTablePath(opt_tablesDirectory, name))) {
       logMessage(LOG_DEBUG, "compiling contraction table: %s", path);
 
-      if (!(table = compileContractionTable(path))) {
+      if ((table = compileContractionTable(path))) {
+        enableAsynchronousContraction(table, handleContractionResponse);
+      } else {
         logMessage(LOG_ERR, "%s: %s", gettext("cannot compile contraction table"), path);
       }
 
@@ -2599,6 +2635,11 @@ brlttyStart (void) {
    * be used instead.
    */
 
+  /* The writer thread mustn't be started until after background() has
+   * forked because threads don't survive into the child.
+   */
+  if (opt_logBuffer && *opt_logFile) bufferLogFile();
+
   changeScreenDriver(opt_screenDriver);
   changeScreenParameters(opt_screenParameters);
   beginSpecialScreens();
@@ -623,26 +623,10 @@ int
 shiftBrailleWindowLeft (unsigned int amount) {
 #ifdef ENABLE_CONTRACTED_BRAILLE
   if (isContracting()) {
-    int reference = ses->winx;
-    int first = 0;
-    int last = ses->winx - 1;
+    int column = findPreviousContractedWindow(amount);
 
-    while (first <= last) {
-      int end = (ses->winx = (first + last) / 2) + getContractedLength(amount);
-
-      if (end < reference) {
-        first = ses->winx + 1;
-      } else {
-        last = ses->winx - 1;
-      }
-    }
-
-    if (first == reference) {
-      if (!first) return 0;
-      first -= 1;
-    }
-
-    ses->winx = first;
+    if (column < 0) return 0;
+    ses->winx = column;
     return 1;
   }
 #endif /* ENABLE_CONTRACTED_BRAILLE */
@@ -936,30 +920,107 @@ getUncontractedCursorOffset (int x, int y) {
          BRL_NO_CURSOR;
 }
 
-int
-getContractedCursor (void) {
-  int offset = getUncontractedCursorOffset(scr.posx, scr.posy);
-
-  return ((offset != BRL_NO_CURSOR) && !ses->hideScreenCursor)?
-         offset:
+static int
+getContractedCursorAt (int column, int row) {
+  return ((row == scr.posy) && (scr.posx >= column) && (scr.posx < scr.cols) && !ses->hideScreenCursor)?
+         (scr.posx - column):
          CTB_NO_CURSOR;
 }
 
 int
-getContractedLength (unsigned int outputLimit) {
-  int inputLength = scr.cols - ses->winx;
-  wchar_t inputBuffer[inputLength];
+getContractedCursor (void) {
+  return getContractedCursorAt(ses->winx, ses->winy);
+}
 
+typedef int ContractedLengthGetter (int column, int row, unsigned int outputLimit);
+
+static int
+getContractedLengthAt (int column, int row, unsigned int outputLimit) {
+  const int columns = scr.cols - column;
+  wchar_t inputBuffer[columns];
+  unsigned char outputBuffer[outputLimit];
+
+  int inputLength = columns;
   int outputLength = outputLimit;
-  unsigned char outputBuffer[outputLength];
 
-  readScreenText(ses->winx, ses->winy, inputLength, 1, inputBuffer);
+  readScreenText(column, row, inputLength, 1, inputBuffer);
   contractText(contractionTable,
                inputBuffer, &inputLength,
                outputBuffer, &outputLength,
-               NULL, getContractedCursor());
+               NULL, getContractedCursorAt(column, row));
+
+  /* Window navigation mustn't be based on the provisional (uncontracted)
+   * result of an asynchronous contraction, so wait for the real one.
+   */
+  if (isContractionProvisional(contractionTable)) {
+    if (awaitContraction(contractionTable)) {
+      inputLength = columns;
+      outputLength = outputLimit;
+
+      contractText(contractionTable,
+                   inputBuffer, &inputLength,
+                   outputBuffer, &outputLength,
+                   NULL, getContractedCursorAt(column, row));
+    }
+  }
+
   return inputLength;
 }
+
+int
+getContractedLength (unsigned int outputLimit) {
+  return getContractedLengthAt(ses->winx, ses->winy, outputLimit);
+}
+
+int
+prefetchContractedLength (int column, int row, unsigned int outputLimit) {
+  int inputLength = scr.cols - column;
+
+  if ((inputLength < 1) || (row < 0) || (row >= scr.rows)) return 0;
+
+  {
+    wchar_t inputBuffer[inputLength];
+
+    readScreenText(column, row, inputLength, 1, inputBuffer);
+    return prefetchContraction(contractionTable,
+                               inputBuffer, inputLength, outputLimit,
+                               getContractedCursorAt(column, row));
+  }
+}
+
+static int
+findPreviousWindow (int column, int row, unsigned int amount, ContractedLengthGetter *getLength) {
+  int first = 0;
+  int last = column - 1;
+
+  while (first <= last) {
+    int start = (first + last) / 2;
+    int end = start + getLength(start, row, amount);
+
+    if (end < column) {
+      first = start + 1;
+    } else {
+      last = start - 1;
+    }
+  }
+
+  if (first == column) {
+    if (!first) return -1;
+    first -= 1;
+  }
+
+  return first;
+}
+
+int
+findPreviousContractedWindow (unsigned int amount) {
+  return findPreviousWindow(ses->winx, ses->winy, amount, getContractedLengthAt);
+}
+
+int
+prefetchPreviousContractedWindow (int column, int row, unsigned int amount) {
+  return findPreviousWindow(column, row, amount, prefetchContractedLength);
+}
 #endif /* ENABLE_CONTRACTED_BRAILLE */
 
 int
@@ -124,6 +124,10 @@ extern int isContracting (void);
 extern int getUncontractedCursorOffset (int x, int y);
 extern int getContractedCursor (void);
 extern int getContractedLength (unsigned int outputLimit);
+extern int findPreviousContractedWindow (unsigned int amount);
+
+extern int prefetchContractedLength (int column, int row, unsigned int outputLimit);
+extern int prefetchPreviousContractedWindow (int column, int row, unsigned int amount);
 #endif /* ENABLE_CONTRACTED_BRAILLE */
 
 extern ContractionTable *contractionTable;
@@ -552,6 +552,28 @@ startContractionCommand (ContractionTable *table) {
 
 void
 stopContractionCommand (ContractionTable *table) {
+  if (table->data.external.asynchronous.monitor) {
+    asyncCancelRequest(table->data.external.asynchronous.monitor);
+    table->data.external.asynchronous.monitor = NULL;
+  }
+
+  if (table->data.external.asynchronous.alarm) {
+    asyncCancelRequest(table->data.external.asynchronous.alarm);
+    table->data.external.asynchronous.alarm = NULL;
+  }
+
+  {
+    ContractionRequest *request = table->requests.array;
+    const ContractionRequest *end = request + ARRAY_COUNT(table->requests.array);
+
+    while (request < end) {
+      request->isPending = 0;
+      request += 1;
+    }
+
+    table->data.external.asynchronous.responseSequence = table->requests.nextSequence;
+  }
+
   if (table->data.external.commandStarted) {
     fclose(table->data.external.standardInput);
     fclose(table->data.external.standardOutput);
@@ -561,6 +583,21 @@ stopContractionCommand (ContractionTable *table) {
   }
 }
 
+static void
+destroyContractionRequests (ContractionTable *table) {
+  ContractionRequest *request = table->requests.array;
+  const ContractionRequest *end = request + ARRAY_COUNT(table->requests.array);
+
+  while (request < end) {
+    if (request->input.characters) free(request->input.characters);
+    if (request->output.cells) free(request->output.cells);
+    if (request->offsets.array) free(request->offsets.array);
+
+    memset(request, 0, sizeof(*request));
+    request += 1;
+  }
+}
+
 static void
 initializeCommonFields (ContractionTable *table) {
   table->characters.array = NULL;
@@ -578,6 +615,50 @@ initializeCommonFields (ContractionTable *table) {
   table->cache.offsets.array = NULL;
   table->cache.offsets.size = 0;
   table->cache.offsets.count = 0;
+
+  table->cache.checkpoints.array = NULL;
+  table->cache.checkpoints.size = 0;
+  table->cache.checkpoints.count = 0;
+
+  table->longestRule = 0;
+
+  memset(table->requests.array, 0, sizeof(table->requests.array));
+  table->requests.nextSequence = 0;
+
+  table->statistics.normalization.skipped = 0;
+  table->statistics.normalization.performed = 0;
+  table->statistics.normalization.applied = 0;
+
+  table->statistics.contraction.complete = 0;
+  table->statistics.contraction.resumed = 0;
+}
+
+static ContractionTable *
+loadCachedContractionTable (const char *fileName) {
+  TableCacheMapping *mapping;
+  size_t size;
+  const void *bytes = mapCachedTable("ctb", fileName, &size, &mapping);
+
+  if (bytes) {
+    ContractionTable *table = malloc(sizeof(*table));
+
+    if (table) {
+      memset(table, 0, sizeof(*table));
+      initializeCommonFields(table);
+      table->command = NULL;
+
+      table->data.internal.header.bytes = bytes;
+      table->data.internal.size = size;
+      table->data.internal.mapping = mapping;
+      return table;
+    } else {
+      logMallocError();
+    }
+
+    unmapCachedTable(mapping);
+  }
+
+  return NULL;
 }
 
 ContractionTable *
@@ -595,6 +676,13 @@ compileContractionTable (const char *fileName) {
         table->data.external.input.buffer = NULL;
         table->data.external.input.size = 0;
 
+        table->data.external.asynchronous.handler = NULL;
+        table->data.external.asynchronous.monitor = NULL;
+        table->data.external.asynchronous.alarm = NULL;
+        table->data.external.asynchronous.responseSequence = 0;
+        table->data.external.asynchronous.provisionalSequence = 0;
+        table->data.external.asynchronous.isProvisional = 0;
+
         if (startContractionCommand(table)) {
           return table;
         }
@@ -612,7 +700,10 @@ compileContractionTable (const char *fileName) {
     return NULL;
   }
 
+  if ((table = loadCachedContractionTable(fileName))) return table;
+
   if (setTableDataVariables(CONTRACTION_TABLE_EXTENSION, CONTRACTION_SUBTABLE_EXTENSION)) {
+    TableCacheRecorder *recorder = startTableCacheRecorder("ctb", fileName);
     ContractionTableData ctd;
     memset(&ctd, 0, sizeof(ctd));
 
@@ -646,6 +737,7 @@ compileContractionTable (const char *fileName) {
 
                 table->data.internal.header.fields = getContractionTableHeader(&ctd);
                 table->data.internal.size = getDataSize(ctd.area);
+                table->data.internal.mapping = NULL;
                 resetDataArea(ctd.area);
               } else {
                 logMallocError();
@@ -661,6 +753,14 @@ compileContractionTable (const char *fileName) {
     }
 
     if (ctd.characterTable) free(ctd.characterTable);
+
+    if (recorder) {
+      if (table) {
+        stopTableCacheRecorder(recorder, table->data.internal.header.bytes, table->data.internal.size);
+      } else {
+        stopTableCacheRecorder(recorder, NULL, 0);
+      }
+    }
   }
 
   return table;
@@ -668,6 +768,21 @@ compileContractionTable (const char *fileName) {
 
 void
 destroyContractionTable (ContractionTable *table) {
+  if (table->statistics.normalization.skipped || table->statistics.normalization.performed) {
+    logMessage(LOG_DEBUG,
+               "normalization statistics: %lu skipped, %lu performed, %lu applied",
+               table->statistics.normalization.skipped,
+               table->statistics.normalization.performed,
+               table->statistics.normalization.applied);
+  }
+
+  if (table->statistics.contraction.complete || table->statistics.contraction.resumed) {
+    logMessage(LOG_DEBUG,
+               "contraction statistics: %lu complete, %lu resumed",
+               table->statistics.contraction.complete,
+               table->statistics.contraction.resumed);
+  }
+
   if (table->characters.array) {
     free(table->characters.array);
     table->characters.array = NULL;
@@ -688,6 +803,13 @@ destroyContractionTable (ContractionTable *table) {
     table->cache.offsets.array = NULL;
   }
 
+  if (table->cache.checkpoints.array) {
+    free(table->cache.checkpoints.array);
+    table->cache.checkpoints.array = NULL;
+  }
+
+  destroyContractionRequests(table);
+
   if (table->command) {
     stopContractionCommand(table);
     if (table->data.external.input.buffer) free(table->data.external.input.buffer);
@@ -695,7 +817,12 @@ destroyContractionTable (ContractionTable *table) {
     free(table);
   } else {
     if (table->data.internal.size) {
-      free(table->data.internal.header.fields);
+      if (table->data.internal.mapping) {
+        unmapCachedTable(table->data.internal.mapping);
+      } else {
+        free(table->data.internal.header.fields);
+      }
+
       free(table);
     }
   }
@@ -21,6 +21,11 @@
 
 #include <stdio.h>
 
+#include "tbl_cache.h"
+#include "async.h"
+#include "timing.h"
+#include "parameters.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -119,6 +124,42 @@ typedef struct {
   const ContractionTableRule *always;
 } CharacterEntry;
 
+typedef struct {
+  unsigned int sequence;
+  TimePeriod timeout;
+  unsigned isPending:1;
+  unsigned isReady:1;
+
+  struct {
+    wchar_t *characters;
+    unsigned int size;
+    unsigned int count;
+    unsigned int consumed;
+    int cursorOffset;
+  } input;
+
+  struct {
+    unsigned char *cells;
+    unsigned int size;
+    unsigned int count;
+    unsigned int maximum;
+  } output;
+
+  struct {
+    int *array;
+    unsigned int size;
+  } offsets;
+
+  unsigned char expandCurrentWord;
+  unsigned char capitalizationMode;
+} ContractionRequest;
+
+typedef struct {
+  unsigned int input;
+  unsigned int output;
+  ContractionTableOpcode previousOpcode;
+} ContractionCheckpoint;
+
 struct ContractionTableStruct {
   struct {
     CharacterEntry *array;
@@ -147,11 +188,37 @@ struct ContractionTableStruct {
       unsigned int count;
     } offsets;
 
+    struct {
+      ContractionCheckpoint *array;
+      unsigned int size;
+      unsigned int count;
+    } checkpoints;
+
     int cursorOffset;
     unsigned char expandCurrentWord;
     unsigned char capitalizationMode;
   } cache;
 
+  unsigned int longestRule;
+
+  struct {
+    ContractionRequest array[CONTRACTION_REQUEST_LIMIT];
+    unsigned int nextSequence;
+  } requests;
+
+  struct {
+    struct {
+      unsigned long int skipped;
+      unsigned long int performed;
+      unsigned long int applied;
+    } normalization;
+
+    struct {
+      unsigned long int complete;
+      unsigned long int resumed;
+    } contraction;
+  } statistics;
+
   char *command;
 
   union {
@@ -162,6 +229,7 @@ struct ContractionTableStruct {
       } header;
 
       size_t size;
+      TableCacheMapping *mapping;
     } internal;
 
     struct {
@@ -173,6 +241,15 @@ struct ContractionTableStruct {
         char *buffer;
         size_t size;
       } input;
+
+      struct {
+        ContractionResponseHandler *handler;
+        AsyncHandle monitor;
+        AsyncHandle alarm;
+        unsigned int responseSequence;
+        unsigned int provisionalSequence;
+        unsigned isProvisional:1;
+      } asynchronous;
     } external;
   } data;
 };
@@ -37,6 +37,9 @@
 #include "log.h"
 #include "file.h"
 #include "parse.h"
+#include "async_io.h"
+#include "async_alarm.h"
+#include "async_wait.h"
 
 typedef struct {
   ContractionTable *const table;
@@ -67,6 +70,10 @@ typedef struct {
   struct {
     ContractionTableOpcode opcode;
   } previous;
+
+  unsigned isProvisional:1;
+  unsigned useCheckpoints:1;
+  unsigned isPrefetch:1;
 } BrailleContractionData;
 
 static inline unsigned int
@@ -1044,6 +1051,21 @@ nextBaseCharacter (const UChar **current, const UChar *end) {
   return 1;
 }
 
+/* Nothing before the combining diacritical marks block is ever changed by
+ * (or combines with anything under) NFC, and that's nearly all terminal text.
+ */
+#define FIRST_NORMALIZABLE_CHARACTER 0X300
+
+static int
+isNormalizedText (BrailleContractionData *bcd, const wchar_t *begin, const wchar_t *end) {
+  while (begin < end) {
+    if ((uint32_t)*begin++ >= FIRST_NORMALIZABLE_CHARACTER) return 0;
+  }
+
+  bcd->table->statistics.normalization.skipped += 1;
+  return 1;
+}
+
 static int
 normalizeText (
   BrailleContractionData *bcd,
@@ -1056,6 +1078,8 @@ normalizeText (
   UChar target[size];
   int32_t count;
 
+  bcd->table->statistics.normalization.performed += 1;
+
   {
     const wchar_t *wc = begin;
     UChar *uc = source;
@@ -1099,6 +1123,7 @@ normalizeText (
     *map = src - source;
   }
 
+  bcd->table->statistics.normalization.applied += 1;
   *length = count;
   return 1;
 }
@@ -1131,6 +1156,11 @@ findLineBreakOpportunities (
   }
 }
 
+static int
+isNormalizedText (BrailleContractionData *bcd, const wchar_t *begin, const wchar_t *end) {
+  return 1;
+}
+
 static int
 normalizeText (
   BrailleContractionData *bcd,
@@ -1142,6 +1172,138 @@ normalizeText (
 }
 #endif /* HAVE_ICU */
 
+static inline int
+makeCachedCursorOffset (BrailleContractionData *bcd) {
+  return bcd->input.cursor? (bcd->input.cursor - bcd->input.begin): CTB_NO_CURSOR;
+}
+
+static unsigned int
+getLongestRule (BrailleContractionData *bcd) {
+  if (!bcd->table->longestRule) {
+    const ContractionTableHeader *header = getContractionTableHeader(bcd);
+    unsigned int longest = 1;
+    unsigned int index;
+
+    for (index=0; index<HASHNUM; index+=1) {
+      ContractionTableOffset offset = header->rules[index];
+
+      if (offset) {
+        /* each chain is ordered by decreasing length */
+        const ContractionTableRule *rule = getContractionTableItem(bcd, offset);
+        if (rule->findlen > longest) longest = rule->findlen;
+      }
+    }
+
+    bcd->table->longestRule = longest;
+  }
+
+  return bcd->table->longestRule;
+}
+
+static void
+addCheckpoint (BrailleContractionData *bcd) {
+  ContractionTable *table = bcd->table;
+
+  if (table->cache.checkpoints.count == table->cache.checkpoints.size) {
+    unsigned int newSize = table->cache.checkpoints.size? table->cache.checkpoints.size<<1: 0X20;
+    ContractionCheckpoint *newArray = realloc(table->cache.checkpoints.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      return;
+    }
+
+    table->cache.checkpoints.array = newArray;
+    table->cache.checkpoints.size = newSize;
+  }
+
+  {
+    ContractionCheckpoint *checkpoint = &table->cache.checkpoints.array[table->cache.checkpoints.count++];
+
+    checkpoint->input = getInputConsumed(bcd);
+    checkpoint->output = getOutputConsumed(bcd);
+    checkpoint->previousOpcode = bcd->previous.opcode;
+  }
+}
+
+static void
+discardCheckpoints (BrailleContractionData *bcd) {
+  if (!bcd->useCheckpoints) return;
+
+  unsigned int input = getInputConsumed(bcd);
+  unsigned int output = getOutputConsumed(bcd);
+
+  while (bcd->table->cache.checkpoints.count) {
+    const ContractionCheckpoint *checkpoint = &bcd->table->cache.checkpoints.array[bcd->table->cache.checkpoints.count - 1];
+    if ((checkpoint->input <= input) && (checkpoint->output <= output)) break;
+    bcd->table->cache.checkpoints.count -= 1;
+  }
+}
+
+static const ContractionCheckpoint *
+findCheckpoint (BrailleContractionData *bcd) {
+  const ContractionTable *table = bcd->table;
+  unsigned int change = 0;
+
+  if (!table->cache.checkpoints.count) return NULL;
+  if (!table->cache.input.characters) return NULL;
+  if (!table->cache.output.cells) return NULL;
+  if (bcd->input.offsets && !table->cache.offsets.count) return NULL;
+  if (table->cache.output.maximum != getOutputCount(bcd)) return NULL;
+  if (table->cache.expandCurrentWord != prefs.expandCurrentWord) return NULL;
+  if (table->cache.capitalizationMode != prefs.capitalizationMode) return NULL;
+
+  {
+    unsigned int count = getInputCount(bcd);
+    if (table->cache.input.count < count) count = table->cache.input.count;
+
+    while ((change < count) && (bcd->input.begin[change] == table->cache.input.characters[change])) {
+      change += 1;
+    }
+  }
+
+  {
+    int cursor = makeCachedCursorOffset(bcd);
+
+    if (cursor != table->cache.cursorOffset) {
+      if ((cursor != CTB_NO_CURSOR) && ((unsigned int)cursor < change)) change = cursor;
+
+      if ((table->cache.cursorOffset != CTB_NO_CURSOR) && ((unsigned int)table->cache.cursorOffset < change)) {
+        change = table->cache.cursorOffset;
+      }
+    }
+  }
+
+  {
+    const wchar_t *limit = bcd->input.begin + change;
+    unsigned int longest = getLongestRule(bcd);
+    unsigned int index = table->cache.checkpoints.count;
+
+    while (index > 0) {
+      const ContractionCheckpoint *checkpoint = &table->cache.checkpoints.array[--index];
+
+      if (checkpoint->input > table->cache.input.count) continue;
+      if (checkpoint->output > table->cache.output.count) continue;
+
+      {
+        /* Rule selection before the checkpoint may have looked at the
+         * characters covered by the longest rule as well as at any run of
+         * spaces and punctuation which follows them. All of those must be
+         * unchanged.
+         */
+        const wchar_t *character = bcd->input.begin + checkpoint->input - 1 + longest;
+
+        while (character < limit) {
+          if (!testCharacter(bcd, *character, CTC_Space|CTC_Punctuation)) return checkpoint;
+          character += 1;
+        }
+      }
+    }
+  }
+
+  return NULL;
+}
+
 static int
 contractTextInternally (BrailleContractionData *bcd) {
   const wchar_t *srcword = NULL;
@@ -1159,6 +1321,34 @@ contractTextInternally (BrailleContractionData *bcd) {
   prepareLineBreakOpportunitiesState(&lbo);
   bcd->previous.opcode = CTO_None;
 
+  if (bcd->useCheckpoints) {
+    const ContractionCheckpoint *checkpoint = findCheckpoint(bcd);
+
+    if (checkpoint) {
+      memcpy(bcd->output.begin, bcd->table->cache.output.cells,
+             ARRAY_SIZE(bcd->output.begin, checkpoint->output));
+
+      if (bcd->input.offsets) {
+        memcpy(bcd->input.offsets, bcd->table->cache.offsets.array,
+               ARRAY_SIZE(bcd->input.offsets, checkpoint->input));
+      }
+
+      bcd->input.current = bcd->input.begin + checkpoint->input;
+      bcd->output.current = bcd->output.begin + checkpoint->output;
+      bcd->previous.opcode = checkpoint->previousOpcode;
+
+      srcword = srcjoin = bcd->input.current;
+      destword = destjoin = bcd->output.current;
+      findLineBreakOpportunities(bcd, &lbo, lineBreakOpportunities, bcd->input.begin, checkpoint->input);
+
+      bcd->table->cache.checkpoints.count = checkpoint - bcd->table->cache.checkpoints.array + 1;
+      bcd->table->statistics.contraction.resumed += 1;
+    } else {
+      bcd->table->cache.checkpoints.count = 0;
+      bcd->table->statistics.contraction.complete += 1;
+    }
+  }
+
   while (bcd->input.current < bcd->input.end) {
     int wasLiteral = bcd->input.current == literal;
 
@@ -1245,6 +1435,8 @@ contractTextInternally (BrailleContractionData *bcd) {
                 destptr += 1;
               }
             }
+
+            discardCheckpoints(bcd);
           }
           break;
 
@@ -1305,7 +1497,11 @@ contractTextInternally (BrailleContractionData *bcd) {
 
         if (srcbeg && (bcd->input.cursor >= srcbeg) && (bcd->input.cursor < bcd->input.current)) {
           int repeat = !literal;
-          literal = bcd->input.current;
+
+          /* Don't shorten a literal which is already pending - doing so
+           * can end it in front of the rule which started it.
+           */
+          if (!literal || (literal < bcd->input.current)) literal = bcd->input.current;
 
           if (repeat) {
             bcd->input.current = srcbeg;
@@ -1336,6 +1532,10 @@ contractTextInternally (BrailleContractionData *bcd) {
     if ((bcd->output.current == bcd->output.begin) || bcd->output.current[-1]) {
       bcd->previous.opcode = bcd->current.opcode;
     }
+
+    if (bcd->useCheckpoints && !literal && (srcword == bcd->input.current)) {
+      addCheckpoint(bcd);
+    }
   }
 
 done:
@@ -1348,6 +1548,8 @@ done:
     } else if (destlast) {
       bcd->output.current = destlast;
     }
+
+    discardCheckpoints(bcd);
   }
 
   return 1;
@@ -1617,45 +1819,440 @@ static const ExternalResponseEntry externalResponseTable[] = {
   { .name = NULL }
 };
 
+static int
+processExternalResponse (BrailleContractionData *bcd, char *response) {
+  int ok = 0;
+  int stop = 0;
+  char *delimiter = strchr(response, '=');
+
+  if (delimiter) {
+    const char *value = delimiter + 1;
+    const ExternalResponseEntry *rsp = externalResponseTable;
+
+    char oldDelimiter = *delimiter;
+    *delimiter = 0;
+
+    while (rsp->name) {
+      if (strcmp(response, rsp->name) == 0) {
+        if (rsp->handler(bcd, value)) ok = 1;
+        if (rsp->stop) stop = 1;
+        break;
+      }
+
+      rsp += 1;
+    }
+
+    *delimiter = oldDelimiter;
+  }
+
+  if (!ok) logMessage(LOG_WARNING, "unexpected external contraction response: %s: %s", bcd->table->command, response);
+  return stop;
+}
+
 static int
 getExternalResponses (BrailleContractionData *bcd) {
   FILE *stream = bcd->table->data.external.standardOutput;
 
   while (readLine(stream, &bcd->table->data.external.input.buffer, &bcd->table->data.external.input.size)) {
-    int ok = 0;
-    int stop = 0;
-    char *delimiter = strchr(bcd->table->data.external.input.buffer, '=');
+    if (processExternalResponse(bcd, bcd->table->data.external.input.buffer)) return 1;
+  }
 
-    if (delimiter) {
-      const char *value = delimiter + 1;
-      const ExternalResponseEntry *rsp = externalResponseTable;
+  logMessage(LOG_WARNING, "incomplete external contraction response: %s", bcd->table->command);
+  return 0;
+}
 
-      char oldDelimiter = *delimiter;
-      *delimiter = 0;
+static int
+testContractionRequest (
+  const ContractionRequest *request,
+  BrailleContractionData *bcd, int ignoreCursor
+) {
+  unsigned int count = getInputCount(bcd);
+
+  if (request->input.count != count) return 0;
+  if (request->output.maximum != getOutputCount(bcd)) return 0;
+  if (!ignoreCursor && (request->input.cursorOffset != makeCachedCursorOffset(bcd))) return 0;
+  if (request->expandCurrentWord != prefs.expandCurrentWord) return 0;
+  if (request->capitalizationMode != prefs.capitalizationMode) return 0;
+  if (wmemcmp(request->input.characters, bcd->input.begin, count) != 0) return 0;
+  return 1;
+}
 
-      while (rsp->name) {
-        if (strcmp(bcd->table->data.external.input.buffer, rsp->name) == 0) {
-          if (rsp->handler(bcd, value)) ok = 1;
-          if (rsp->stop) stop = 1;
-          break;
+static ContractionRequest *
+findContractionRequest (BrailleContractionData *bcd, int ignoreCursor) {
+  ContractionRequest *request = bcd->table->requests.array;
+  const ContractionRequest *end = request + ARRAY_COUNT(bcd->table->requests.array);
+
+  while (request < end) {
+    if (request->isPending || request->isReady) {
+      if (!ignoreCursor || request->isReady) {
+        if (testContractionRequest(request, bcd, ignoreCursor)) {
+          return request;
         }
+      }
+    }
+
+    request += 1;
+  }
+
+  return NULL;
+}
+
+static ContractionRequest *
+getPendingExternalRequest (ContractionTable *table) {
+  ContractionRequest *request = table->requests.array;
+  const ContractionRequest *end = request + ARRAY_COUNT(table->requests.array);
+
+  while (request < end) {
+    if (request->isPending) {
+      if (request->sequence == table->data.external.asynchronous.responseSequence) {
+        return request;
+      }
+    }
 
-        rsp += 1;
+    request += 1;
+  }
+
+  return NULL;
+}
+
+static ContractionRequest *
+allocateContractionRequest (ContractionTable *table) {
+  ContractionRequest *request = table->requests.array;
+  const ContractionRequest *end = request + ARRAY_COUNT(table->requests.array);
+  ContractionRequest *oldest = NULL;
+
+  while (request < end) {
+    if (!request->isPending) {
+      if (!request->isReady) return request;
+
+      if (!oldest || ((int)(request->sequence - oldest->sequence) < 0)) {
+        oldest = request;
       }
+    }
+
+    request += 1;
+  }
+
+  return oldest;
+}
 
-      *delimiter = oldDelimiter;
+static int
+ensureContractionRequestBuffer (void **buffer, unsigned int *size, unsigned int count, size_t element) {
+  if (count > *size) {
+    unsigned int newSize = count | 0X7F;
+    void *newBuffer = realloc(*buffer, (newSize * element));
+
+    if (!newBuffer) {
+      logMallocError();
+      return 0;
     }
 
-    if (!ok) logMessage(LOG_WARNING, "unexpected external contraction response: %s: %s", bcd->table->command, bcd->table->data.external.input.buffer);
-    if (stop) return 1;
+    *buffer = newBuffer;
+    *size = newSize;
   }
 
-  logMessage(LOG_WARNING, "incomplete external contraction response: %s", bcd->table->command);
+  return 1;
+}
+
+static int
+saveContractionRequest (ContractionRequest *request, BrailleContractionData *bcd) {
+  unsigned int count = getInputCount(bcd);
+  unsigned int maximum = getOutputCount(bcd);
+
+  request->isReady = 0;
+
+  if (!ensureContractionRequestBuffer((void **)&request->input.characters, &request->input.size,
+                                   count, sizeof(*request->input.characters))) {
+    return 0;
+  }
+
+  if (!ensureContractionRequestBuffer((void **)&request->output.cells, &request->output.size,
+                                   maximum, sizeof(*request->output.cells))) {
+    return 0;
+  }
+
+  if (!ensureContractionRequestBuffer((void **)&request->offsets.array, &request->offsets.size,
+                                   count, sizeof(*request->offsets.array))) {
+    return 0;
+  }
+
+  wmemcpy(request->input.characters, bcd->input.begin, count);
+  request->input.count = count;
+  request->input.consumed = count;
+  request->input.cursorOffset = makeCachedCursorOffset(bcd);
+
+  request->output.count = 0;
+  request->output.maximum = maximum;
+
+  if (count) {
+    unsigned int index = 0;
+
+    request->offsets.array[index] = 0;
+    while (++index < count) request->offsets.array[index] = CTB_NO_OFFSET;
+  }
+
+  request->expandCurrentWord = prefs.expandCurrentWord;
+  request->capitalizationMode = prefs.capitalizationMode;
+  return 1;
+}
+
+static void
+handleExternalResponseLine (ContractionTable *table, char *line) {
+  ContractionRequest *request = getPendingExternalRequest(table);
+
+  if (request) {
+    BrailleContractionData bcd = {
+      .table = table,
+
+      .input = {
+        .begin = request->input.characters,
+        .current = request->input.characters + request->input.consumed,
+        .end = request->input.characters + request->input.count,
+        .offsets = request->offsets.array
+      },
+
+      .output = {
+        .begin = request->output.cells,
+        .current = request->output.cells + request->output.count,
+        .end = request->output.cells + request->output.maximum
+      }
+    };
+
+    if (request->input.cursorOffset != CTB_NO_CURSOR) {
+      bcd.input.cursor = &bcd.input.begin[request->input.cursorOffset];
+    }
+
+    {
+      int stop = processExternalResponse(&bcd, line);
+
+      request->input.consumed = getInputConsumed(&bcd);
+      request->output.count = getOutputConsumed(&bcd);
+
+      if (stop) {
+        request->isPending = 0;
+        request->isReady = 1;
+        table->data.external.asynchronous.responseSequence += 1;
+        table->data.external.asynchronous.handler();
+      }
+    }
+  } else {
+    logMessage(LOG_WARNING, "unsolicited external contraction response: %s: %s", table->command, line);
+  }
+}
+
+ASYNC_INPUT_CALLBACK(handleExternalContractionInput) {
+  ContractionTable *table = parameters->data;
+
+  if (parameters->error) {
+    logMessage(LOG_WARNING, "external contraction input error: %s: %s",
+               table->command, strerror(parameters->error));
+  } else if (parameters->end) {
+    logMessage(LOG_WARNING, "external contraction end-of-file: %s", table->command);
+  } else {
+    const char *buffer = parameters->buffer;
+    const char *start = buffer;
+    const char *end = start + parameters->length;
+    const char *newline;
+
+    while ((newline = memchr(start, '\n', (end - start)))) {
+      size_t length = newline - start;
+      char line[length + 1];
+
+      memcpy(line, start, length);
+      line[length] = 0;
+      handleExternalResponseLine(table, line);
+
+      start = newline + 1;
+    }
+
+    if ((start == buffer) && (parameters->length == parameters->size)) {
+      logMessage(LOG_WARNING, "external contraction response too long: %s", table->command);
+      return parameters->length;
+    }
+
+    return start - buffer;
+  }
+
+  asyncDiscardHandle(table->data.external.asynchronous.monitor);
+  table->data.external.asynchronous.monitor = NULL;
+  stopContractionCommand(table);
   return 0;
 }
 
+static int
+startExternalContraction (ContractionTable *table) {
+  if (!startContractionCommand(table)) return 0;
+
+  if (!table->data.external.asynchronous.monitor) {
+    if (!asyncReadFile(&table->data.external.asynchronous.monitor,
+                       fileno(table->data.external.standardOutput),
+                       CONTRACTION_EXTERNAL_INPUT_SIZE,
+                       handleExternalContractionInput, table)) {
+      stopContractionCommand(table);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+checkExternalResponseTimeout (ContractionTable *table) {
+  const ContractionRequest *request = getPendingExternalRequest(table);
+
+  if (request && afterTimePeriod(&request->timeout, NULL)) {
+    logMessage(LOG_WARNING, "external contraction response timeout: %s", table->command);
+    stopContractionCommand(table);
+    return 1;
+  }
+
+  return 0;
+}
+
+static void setExternalResponseAlarm (ContractionTable *table);
+
+ASYNC_ALARM_CALLBACK(handleExternalResponseAlarm) {
+  ContractionTable *table = parameters->data;
+
+  asyncDiscardHandle(table->data.external.asynchronous.alarm);
+  table->data.external.asynchronous.alarm = NULL;
+
+  if (checkExternalResponseTimeout(table)) {
+    table->data.external.asynchronous.handler();
+  } else {
+    setExternalResponseAlarm(table);
+  }
+}
+
+static void
+setExternalResponseAlarm (ContractionTable *table) {
+  if (!table->data.external.asynchronous.alarm) {
+    const ContractionRequest *request = getPendingExternalRequest(table);
+
+    if (request) {
+      long int elapsed;
+      long int interval;
+
+      afterTimePeriod(&request->timeout, &elapsed);
+      interval = request->timeout.length - elapsed;
+      if (interval < 0) interval = 0;
+
+      asyncSetAlarmIn(&table->data.external.asynchronous.alarm, interval,
+                      handleExternalResponseAlarm, table);
+    }
+  }
+}
+
+static const ContractionRequest *
+sendExternalRequest (BrailleContractionData *bcd) {
+  ContractionTable *table = bcd->table;
+  ContractionRequest *request = allocateContractionRequest(table);
+
+  if (!request) return NULL;
+  if (!saveContractionRequest(request, bcd)) return NULL;
+  if (!startExternalContraction(table)) return NULL;
+
+  if (!putExternalRequests(bcd)) {
+    stopContractionCommand(table);
+    return NULL;
+  }
+
+  request->sequence = table->requests.nextSequence++;
+  request->isPending = 1;
+  startTimePeriod(&request->timeout, CONTRACTION_EXTERNAL_RESPONSE_TIMEOUT);
+  setExternalResponseAlarm(table);
+  return request;
+}
+
+static void
+applyContractionRequest (BrailleContractionData *bcd, const ContractionRequest *request) {
+  bcd->input.current = bcd->input.begin + request->input.consumed;
+
+  memcpy(bcd->output.begin, request->output.cells,
+         ARRAY_SIZE(bcd->output.begin, request->output.count));
+  bcd->output.current = bcd->output.begin + request->output.count;
+
+  if (bcd->input.offsets) {
+    memcpy(bcd->input.offsets, request->offsets.array,
+           ARRAY_SIZE(bcd->input.offsets, request->input.count));
+  }
+}
+
+static int
+contractTextAsynchronously (BrailleContractionData *bcd) {
+  ContractionTable *table = bcd->table;
+  const ContractionRequest *request;
+
+  checkExternalResponseTimeout(table);
+
+  if ((request = findContractionRequest(bcd, 0))) {
+    if (request->isReady) {
+      applyContractionRequest(bcd, request);
+      return 1;
+    }
+  } else {
+    request = sendExternalRequest(bcd);
+  }
+
+  /* The result is only a placeholder until the response arrives. It's
+   * never cached, and, when the response is still on its way, the table
+   * remembers which request it is so that the caller can wait for it.
+   */
+  bcd->isProvisional = 1;
+
+  if (request) {
+    table->data.external.asynchronous.provisionalSequence = request->sequence;
+    table->data.external.asynchronous.isProvisional = 1;
+  }
+
+  if ((request = findContractionRequest(bcd, 1))) {
+    applyContractionRequest(bcd, request);
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+enableAsynchronousContraction (ContractionTable *table, ContractionResponseHandler *handler) {
+#if defined(__MINGW32__) || defined(__MSDOS__)
+  return 0;
+#else /* asynchronous contraction */
+  if (!table->command) return 0;
+  table->data.external.asynchronous.handler = handler;
+  return 1;
+#endif /* asynchronous contraction */
+}
+
+int
+isAsynchronousContraction (ContractionTable *table) {
+  return table->command && table->data.external.asynchronous.handler;
+}
+
+int
+isContractionProvisional (ContractionTable *table) {
+  return table->command && table->data.external.asynchronous.isProvisional;
+}
+
+ASYNC_CONDITION_TESTER(testContractionResponse) {
+  ContractionTable *table = data;
+
+  return (int)(table->data.external.asynchronous.responseSequence -
+               table->data.external.asynchronous.provisionalSequence) > 0;
+}
+
+int
+awaitContraction (ContractionTable *table) {
+  if (!isContractionProvisional(table)) return 1;
+
+  return asyncAwaitCondition(CONTRACTION_EXTERNAL_RESPONSE_TIMEOUT,
+                             testContractionResponse, table);
+}
+
 static int
 contractTextExternally (BrailleContractionData *bcd) {
+  if (bcd->table->data.external.asynchronous.handler) return contractTextAsynchronously(bcd);
+
   setOffset(bcd);
   while (++bcd->input.current < bcd->input.end) clearOffset(bcd);
 
@@ -1671,9 +2268,13 @@ contractTextExternally (BrailleContractionData *bcd) {
   return 0;
 }
 
-static inline int
-makeCachedCursorOffset (BrailleContractionData *bcd) {
-  return bcd->input.cursor? (bcd->input.cursor - bcd->input.begin): CTB_NO_CURSOR;
+void
+clearContractionCache (ContractionTable *table) {
+  table->cache.input.count = 0;
+  table->cache.output.count = 0;
+  table->cache.output.maximum = 0;
+  table->cache.offsets.count = 0;
+  table->cache.checkpoints.count = 0;
 }
 
 static int
@@ -1770,139 +2371,262 @@ outputDone:
   }
 offsetsDone:
 
+  if (!bcd->useCheckpoints) bcd->table->cache.checkpoints.count = 0;
   bcd->table->cache.cursorOffset = makeCachedCursorOffset(bcd);
   bcd->table->cache.expandCurrentWord = prefs.expandCurrentWord;
   bcd->table->cache.capitalizationMode = prefs.capitalizationMode;
 }
 
-void
-contractText (
-  ContractionTable *contractionTable,
-  const wchar_t *inputBuffer, int *inputLength,
-  BYTE *outputBuffer, int *outputLength,
-  int *offsetsMap, const int cursorOffset
+static const wchar_t *
+mapNormalizedCursor (
+  const wchar_t *cursor, const wchar_t *oldBegin,
+  const wchar_t *newBegin, size_t length, const unsigned int *map
 ) {
-  BrailleContractionData bcd = {
-    .table = contractionTable,
+  const wchar_t *newCursor = NULL;
 
-    .input = {
-      .begin = inputBuffer,
-      .current = inputBuffer,
-      .end = inputBuffer + *inputLength,
-      .cursor = (cursorOffset == CTB_NO_CURSOR)? NULL: &inputBuffer[cursorOffset],
-      .offsets = offsetsMap
-    },
+  if (cursor) {
+    ptrdiff_t offset = cursor - oldBegin;
+    unsigned int mapIndex;
 
-    .output = {
-      .begin = outputBuffer,
-      .end = outputBuffer + *outputLength,
-      .current = outputBuffer
+    for (mapIndex=0; mapIndex<=length; mapIndex+=1) {
+      unsigned int mappedIndex = map[mapIndex];
+
+      if (mappedIndex > offset) break;
+      newCursor = &newBegin[mappedIndex];
     }
-  };
+  }
 
-  if (checkCache(&bcd)) {
-    bcd.input.current = bcd.input.begin + bcd.table->cache.input.consumed;
+  return newCursor;
+}
 
-    if (bcd.input.offsets) {
-      memcpy(bcd.input.offsets, bcd.table->cache.offsets.array,
-             ARRAY_SIZE(bcd.input.offsets, bcd.table->cache.offsets.count));
-    }
+static void
+performContraction (BrailleContractionData *bcd) {
+  int contracted;
 
-    bcd.output.current = bcd.output.begin + bcd.table->cache.output.count;
-    memcpy(bcd.output.begin, bcd.table->cache.output.cells,
-           ARRAY_SIZE(bcd.output.begin, bcd.table->cache.output.count));
-  } else {
-    int contracted;
+  {
+    int (*const contract) (BrailleContractionData *bcd) = bcd->table->command? contractTextExternally: contractTextInternally;
 
-    {
-      int (*const contract) (BrailleContractionData *bcd) = bcd.table->command? contractTextExternally: contractTextInternally;
-      const size_t size = getInputCount(&bcd);
+    if (isNormalizedText(bcd, bcd->input.begin, bcd->input.end)) {
+      bcd->useCheckpoints = !bcd->isPrefetch;
+      contracted = contract(bcd);
+    } else {
+      const size_t size = getInputCount(bcd);
       wchar_t buffer[size];
       unsigned int map[size + 1];
       size_t length;
 
-      if (normalizeText(&bcd, bcd.input.begin, bcd.input.end, buffer, &length, map)) {
-        const wchar_t *oldBegin = bcd.input.begin;
-        const wchar_t *oldEnd = bcd.input.end;
-
-        bcd.input.begin = buffer;
-        bcd.input.current = bcd.input.begin + (bcd.input.current - oldBegin);
-        bcd.input.end = bcd.input.begin + length;
+      if (normalizeText(bcd, bcd->input.begin, bcd->input.end, buffer, &length, map)) {
+        const wchar_t *oldBegin = bcd->input.begin;
+        const wchar_t *oldEnd = bcd->input.end;
 
-        if (bcd.input.cursor) {
-          ptrdiff_t offset = bcd.input.cursor - oldBegin;
-          unsigned int mapIndex;
+        bcd->input.begin = buffer;
+        bcd->input.current = bcd->input.begin + (bcd->input.current - oldBegin);
+        bcd->input.end = bcd->input.begin + length;
 
-          bcd.input.cursor = NULL;
+        bcd->input.cursor = mapNormalizedCursor(bcd->input.cursor, oldBegin, buffer, length, map);
 
-          for (mapIndex=0; mapIndex<=length; mapIndex+=1) {
-            unsigned int mappedIndex = map[mapIndex];
+        contracted = contract(bcd);
 
-            if (mappedIndex > offset) break;
-            bcd.input.cursor = &bcd.input.begin[mappedIndex];
-          }
-        }
-
-        contracted = contract(&bcd);
-
-        if (bcd.input.offsets) {
+        if (bcd->input.offsets) {
           size_t mapIndex = length;
           size_t offsetsIndex = oldEnd - oldBegin;
 
           while (mapIndex > 0) {
             unsigned int mappedIndex = map[--mapIndex];
-            int offset = bcd.input.offsets[mapIndex];
+            int offset = bcd->input.offsets[mapIndex];
 
             if (offset != CTB_NO_OFFSET) {
-              while (--offsetsIndex > mappedIndex) bcd.input.offsets[offsetsIndex] = CTB_NO_OFFSET;
-              bcd.input.offsets[offsetsIndex] = offset;
+              while (--offsetsIndex > mappedIndex) bcd->input.offsets[offsetsIndex] = CTB_NO_OFFSET;
+              bcd->input.offsets[offsetsIndex] = offset;
             }
           }
 
-          while (offsetsIndex > 0) bcd.input.offsets[--offsetsIndex] = CTB_NO_OFFSET;
+          while (offsetsIndex > 0) bcd->input.offsets[--offsetsIndex] = CTB_NO_OFFSET;
         }
 
-        bcd.input.begin = oldBegin;
-        bcd.input.current = bcd.input.begin + map[bcd.input.current - buffer];
-        bcd.input.end = oldEnd;
+        bcd->input.begin = oldBegin;
+        bcd->input.current = bcd->input.begin + map[bcd->input.current - buffer];
+        bcd->input.end = oldEnd;
       } else {
-        contracted = contract(&bcd);
+        contracted = contract(bcd);
       }
     }
+  }
+
+  if (!contracted) {
+    bcd->input.current = bcd->input.begin;
+    bcd->output.current = bcd->output.begin;
+
+    while ((bcd->input.current < bcd->input.end) && (bcd->output.current < bcd->output.end)) {
+      setOffset(bcd);
+      *bcd->output.current++ = convertCharacterToDots(textTable, *bcd->input.current++);
+    }
+  }
 
-    if (!contracted) {
-      bcd.input.current = bcd.input.begin;
-      bcd.output.current = bcd.output.begin;
+  if (bcd->input.current < bcd->input.end) {
+    const wchar_t *srcorig = bcd->input.current;
+    int done = 1;
+
+    setOffset(bcd);
+    while (1) {
+      if (done && !testCurrent(bcd, CTC_Space)) {
+        done = 0;
 
-      while ((bcd.input.current < bcd.input.end) && (bcd.output.current < bcd.output.end)) {
-        setOffset(&bcd);
-        *bcd.output.current++ = convertCharacterToDots(textTable, *bcd.input.current++);
+        if (!bcd->input.cursor || (bcd->input.cursor < srcorig) || (bcd->input.cursor >= bcd->input.current)) {
+          setOffset(bcd);
+          srcorig = bcd->input.current;
+        }
       }
+
+      if (++bcd->input.current == bcd->input.end) break;
+      clearOffset(bcd);
     }
 
-    if (bcd.input.current < bcd.input.end) {
-      const wchar_t *srcorig = bcd.input.current;
-      int done = 1;
+    if (!done) bcd->input.current = srcorig;
+  }
+}
+
+static int
+prefetchInternally (BrailleContractionData *bcd) {
+  ContractionRequest *request;
 
-      setOffset(&bcd);
-      while (1) {
-        if (done && !testCurrent(&bcd, CTC_Space)) {
-          done = 0;
+  if (checkCache(bcd)) return bcd->table->cache.input.consumed;
 
-          if (!bcd.input.cursor || (bcd.input.cursor < srcorig) || (bcd.input.cursor >= bcd.input.current)) {
-            setOffset(&bcd);
-            srcorig = bcd.input.current;
-          }
+  if (!(request = findContractionRequest(bcd, 0))) {
+    if (!(request = allocateContractionRequest(bcd->table))) return 0;
+    if (!saveContractionRequest(request, bcd)) return 0;
+
+    {
+      BrailleContractionData prefetch = {
+        .table = bcd->table,
+
+        .input = {
+          .begin = bcd->input.begin,
+          .current = bcd->input.begin,
+          .end = bcd->input.end,
+          .cursor = bcd->input.cursor,
+          .offsets = request->offsets.array
+        },
+
+        .output = {
+          .begin = request->output.cells,
+          .end = request->output.cells + request->output.maximum,
+          .current = request->output.cells
+        },
+
+        .isPrefetch = 1
+      };
+
+      performContraction(&prefetch);
+      request->input.consumed = getInputConsumed(&prefetch);
+      request->output.count = getOutputConsumed(&prefetch);
+    }
+
+    request->sequence = bcd->table->requests.nextSequence++;
+    request->isReady = 1;
+  }
+
+  return request->input.consumed;
+}
+
+int
+prefetchContraction (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int inputLength,
+  int outputLength, int cursorOffset
+) {
+  if ((inputLength > 0) && (outputLength > 0)) {
+    BYTE outputBuffer[outputLength];
+
+    BrailleContractionData bcd = {
+      .table = contractionTable,
+
+      .input = {
+        .begin = inputBuffer,
+        .current = inputBuffer,
+        .end = inputBuffer + inputLength,
+        .cursor = (cursorOffset == CTB_NO_CURSOR)? NULL: &inputBuffer[cursorOffset]
+      },
+
+      .output = {
+        .begin = outputBuffer,
+        .end = outputBuffer + outputLength,
+        .current = outputBuffer
+      }
+    };
+
+    if (!contractionTable->command) return prefetchInternally(&bcd);
+
+    if (isAsynchronousContraction(contractionTable)) {
+      if (isNormalizedText(&bcd, bcd.input.begin, bcd.input.end)) {
+        if (!findContractionRequest(&bcd, 0)) sendExternalRequest(&bcd);
+      } else {
+        wchar_t buffer[inputLength];
+        unsigned int map[inputLength + 1];
+        size_t length;
+
+        if (normalizeText(&bcd, bcd.input.begin, bcd.input.end, buffer, &length, map)) {
+          bcd.input.cursor = mapNormalizedCursor(bcd.input.cursor, bcd.input.begin, buffer, length, map);
+          bcd.input.begin = bcd.input.current = buffer;
+          bcd.input.end = buffer + length;
         }
 
-        if (++bcd.input.current == bcd.input.end) break;
-        clearOffset(&bcd);
+        if (!findContractionRequest(&bcd, 0)) sendExternalRequest(&bcd);
       }
+    }
+  }
+
+  return 0;
+}
+
+void
+contractText (
+  ContractionTable *contractionTable,
+  const wchar_t *inputBuffer, int *inputLength,
+  BYTE *outputBuffer, int *outputLength,
+  int *offsetsMap, const int cursorOffset
+) {
+  BrailleContractionData bcd = {
+    .table = contractionTable,
 
-      if (!done) bcd.input.current = srcorig;
+    .input = {
+      .begin = inputBuffer,
+      .current = inputBuffer,
+      .end = inputBuffer + *inputLength,
+      .cursor = (cursorOffset == CTB_NO_CURSOR)? NULL: &inputBuffer[cursorOffset],
+      .offsets = offsetsMap
+    },
+
+    .output = {
+      .begin = outputBuffer,
+      .end = outputBuffer + *outputLength,
+      .current = outputBuffer
+    }
+  };
+
+  if (contractionTable->command) contractionTable->data.external.asynchronous.isProvisional = 0;
+
+  if (checkCache(&bcd)) {
+    bcd.input.current = bcd.input.begin + bcd.table->cache.input.consumed;
+
+    if (bcd.input.offsets) {
+      memcpy(bcd.input.offsets, bcd.table->cache.offsets.array,
+             ARRAY_SIZE(bcd.input.offsets, bcd.table->cache.offsets.count));
+    }
+
+    bcd.output.current = bcd.output.begin + bcd.table->cache.output.count;
+    memcpy(bcd.output.begin, bcd.table->cache.output.cells,
+           ARRAY_SIZE(bcd.output.begin, bcd.table->cache.output.count));
+  } else {
+    const ContractionRequest *request;
+
+    if (!bcd.table->command && (request = findContractionRequest(&bcd, 0))) {
+      applyContractionRequest(&bcd, request);
+    } else {
+      performContraction(&bcd);
     }
 
-    updateCache(&bcd);
+    if (!bcd.isProvisional) updateCache(&bcd);
   }
 
   *inputLength = getInputConsumed(&bcd);
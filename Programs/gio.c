@@ -22,6 +22,7 @@
 #include <errno.h>
 
 #include "log.h"
+#include "timing.h"
 #include "async_wait.h"
 #include "async_alarm.h"
 #include "io_generic.h"
@@ -30,6 +31,7 @@
 
 const GioClass *const gioClasses[] = {
   &gioNullClass,
+  &gioReplayClass,
   &gioSerialClass,
   &gioUsbClass,
   &gioBluetoothClass,
@@ -43,6 +45,7 @@ gioInitializeOptions (GioOptions *options) {
   options->inputTimeout = 0;
   options->outputTimeout = 0;
   options->requestTimeout = 0;
+  options->inputBufferSize = GIO_DEFAULT_INPUT_BUFFER_SIZE;
 }
 
 void
@@ -81,6 +84,78 @@ gioSetBytesPerSecond (GioEndpoint *endpoint, const SerialParameters *parameters)
   endpoint->bytesPerSecond = parameters->baud / serialGetCharacterSize(parameters);
 }
 
+static FILE *captureFile = NULL;
+static TimeValue captureStart;
+static unsigned char captureEndpointCount = 0;
+
+void
+gioCloseCaptureFile (void) {
+  if (captureFile) {
+    fclose(captureFile);
+    captureFile = NULL;
+  }
+}
+
+int
+gioOpenCaptureFile (const char *path) {
+  gioCloseCaptureFile();
+
+  if ((captureFile = fopen(path, "wb"))) {
+    static const GioCaptureFileHeader header = {
+      .magic = GIO_CAPTURE_MAGIC,
+      .version = GIO_CAPTURE_VERSION
+    };
+
+    setvbuf(captureFile, NULL, _IOFBF, 0X10000);
+
+    if (fwrite(&header, 1, sizeof(header), captureFile) == sizeof(header)) {
+      getMonotonicTime(&captureStart);
+      logMessage(LOG_DEBUG, "generic I/O capture file: %s", path);
+      return 1;
+    }
+
+    logSystemError("fwrite");
+    gioCloseCaptureFile();
+  } else {
+    logMessage(LOG_WARNING, "cannot open generic I/O capture file: %s: %s",
+               path, strerror(errno));
+  }
+
+  return 0;
+}
+
+static void
+gioCaptureRecord (
+  GioEndpoint *endpoint, GioCaptureRecordType type,
+  const void *data, size_t size
+) {
+  if (captureFile) {
+    const unsigned char *bytes = data;
+
+    while (1) {
+      uint32_t time = getMonotonicElapsed(&captureStart);
+      uint16_t count = MIN(size, UINT16_MAX);
+
+      GioCaptureRecordHeader header = {
+        .time = {time, time >> 8, time >> 16, time >> 24},
+        .type = type,
+        .endpoint = endpoint->captureIdentifier,
+        .size = {count, count >> 8}
+      };
+
+      if ((fwrite(&header, 1, sizeof(header), captureFile) != sizeof(header)) ||
+          (fwrite(bytes, 1, count, captureFile) != count)) {
+        logSystemError("fwrite");
+        gioCloseCaptureFile();
+        break;
+      }
+
+      if (!(size -= count)) break;
+      bytes += count;
+    }
+  }
+}
+
 static int
 gioStartEndpoint (GioEndpoint *endpoint) {
   {
@@ -127,27 +202,41 @@ gioConnectResource (
   const char *identifier,
   const GioDescriptor *descriptor
 ) {
+  const char *resource = identifier;
   const GioClass *class = gioGetClass(&identifier, descriptor);
 
   if (class) {
+    GioOptions options;
     GioEndpoint *endpoint;
 
-    if ((endpoint = malloc(sizeof(*endpoint)))) {
+    if (class->getOptions) {
+      options = *class->getOptions(descriptor);
+    } else {
+      gioInitializeOptions(&options);
+    }
+
+    if (!options.inputBufferSize) options.inputBufferSize = GIO_DEFAULT_INPUT_BUFFER_SIZE;
+
+    if ((endpoint = malloc(sizeof(*endpoint) + options.inputBufferSize))) {
+      endpoint->options = options;
       endpoint->resourceType = class->resourceType;
       endpoint->bytesPerSecond = 0;
 
       endpoint->input.error = 0;
       endpoint->input.from = 0;
       endpoint->input.to = 0;
+      endpoint->input.size = options.inputBufferSize;
+
+      getMonotonicTime(&endpoint->statistics.start);
+      endpoint->statistics.reads = 0;
+      endpoint->statistics.bytes = 0;
+      endpoint->statistics.writes = 0;
+      endpoint->statistics.written = 0;
 
       endpoint->hidReportItems.address = NULL;
       endpoint->hidReportItems.size = 0;
 
-      if (class->getOptions) {
-        endpoint->options = *class->getOptions(descriptor);
-      } else {
-        gioInitializeOptions(&endpoint->options);
-      }
+      endpoint->captureIdentifier = captureEndpointCount++;
 
       if (class->getMethods) {
         endpoint->methods = class->getMethods();
@@ -159,6 +248,7 @@ gioConnectResource (
         if ((endpoint->handle = class->connectResource(identifier, descriptor))) {
           if (!class->prepareEndpoint || class->prepareEndpoint(endpoint)) {
             if (gioStartEndpoint(endpoint)) {
+              gioCaptureRecord(endpoint, GIO_CAPTURE_CONNECT, resource, strlen(resource));
               return endpoint;
             }
           }
@@ -195,6 +285,23 @@ gioDisconnectResource (GioEndpoint *endpoint) {
     ok = 1;
   }
 
+  if (endpoint->statistics.reads) {
+    long int elapsed = getMonotonicElapsed(&endpoint->statistics.start);
+
+    logMessage(LOG_CATEGORY(GENERIC_INPUT),
+               "input statistics: %lu reads, %lu bytes, %lu bytes/read, %lu reads/second",
+               endpoint->statistics.reads, endpoint->statistics.bytes,
+               endpoint->statistics.bytes / endpoint->statistics.reads,
+               (elapsed > 0)? ((endpoint->statistics.reads * MSECS_PER_SEC) / elapsed): 0);
+  }
+
+  if (endpoint->statistics.writes) {
+    logMessage(LOG_CATEGORY(OUTPUT_PACKETS),
+               "output statistics: %lu writes, %lu bytes, %lu bytes/write",
+               endpoint->statistics.writes, endpoint->statistics.written,
+               endpoint->statistics.written / endpoint->statistics.writes);
+  }
+
   if (endpoint->hidReportItems.address) free(endpoint->hidReportItems.address);
   free(endpoint);
   return ok;
@@ -228,8 +335,18 @@ gioWriteData (GioEndpoint *endpoint, const void *data, size_t size) {
     return -1;
   }
 
-  return method(endpoint->handle, data, size,
-                endpoint->options.outputTimeout);
+  {
+    ssize_t result = method(endpoint->handle, data, size,
+                            endpoint->options.outputTimeout);
+
+    if (result > 0) {
+      endpoint->statistics.writes += 1;
+      endpoint->statistics.written += result;
+      gioCaptureRecord(endpoint, GIO_CAPTURE_OUTPUT, data, result);
+    }
+
+    return result;
+  }
 }
 
 int
@@ -286,11 +403,15 @@ gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait) {
       {
         ssize_t result = method(endpoint->handle,
                                 &endpoint->input.buffer[endpoint->input.to],
-                                sizeof(endpoint->input.buffer) - endpoint->input.to,
+                                endpoint->input.size - endpoint->input.to,
                                 (wait? endpoint->options.inputTimeout: 0), 0);
 
         if (result > 0) {
+          endpoint->statistics.reads += 1;
+          endpoint->statistics.bytes += result;
+
           logBytes(LOG_CATEGORY(GENERIC_INPUT), NULL, &endpoint->input.buffer[endpoint->input.to], result);
+          gioCaptureRecord(endpoint, GIO_CAPTURE_INPUT, &endpoint->input.buffer[endpoint->input.to], result);
           endpoint->input.to += result;
           wait = 1;
         } else {
@@ -314,6 +435,25 @@ gioReadByte (GioEndpoint *endpoint, unsigned char *byte, int wait) {
   return 0;
 }
 
+int
+gioUnreadData (GioEndpoint *endpoint, const void *data, size_t size) {
+  unsigned int count = endpoint->input.to - endpoint->input.from;
+
+  if ((count + size) > endpoint->input.size) return 0;
+
+  if (size > endpoint->input.from) {
+    memmove(&endpoint->input.buffer[size],
+            &endpoint->input.buffer[endpoint->input.from], count);
+
+    endpoint->input.from = size;
+    endpoint->input.to = size + count;
+  }
+
+  endpoint->input.from -= size;
+  memcpy(&endpoint->input.buffer[endpoint->input.from], data, size);
+  return 1;
+}
+
 int
 gioDiscardInput (GioEndpoint *endpoint) {
   unsigned char byte;
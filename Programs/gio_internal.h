@@ -19,6 +19,8 @@
 #ifndef BRLTTY_INCLUDED_GIO_INTERNAL
 #define BRLTTY_INCLUDED_GIO_INTERNAL
 
+#include "timing.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -120,15 +122,27 @@ struct GioEndpointStruct {
   GioResourceType resourceType;
   unsigned int bytesPerSecond;
   GioHidReportItemsData hidReportItems;
+  unsigned char captureIdentifier;
+
+  struct {
+    TimeValue start;
+    unsigned long int reads;
+    unsigned long int bytes;
+    unsigned long int writes;
+    unsigned long int written;
+  } statistics;
 
   struct {
     int error;
     unsigned int from;
     unsigned int to;
-    unsigned char buffer[0X40];
+    unsigned int size;
+    unsigned char buffer[0];
   } input;
 };
 
+#define GIO_DEFAULT_INPUT_BUFFER_SIZE 0X40
+
 typedef int GioIsSupportedMethod (const GioDescriptor *descriptor);
 
 typedef int GioTestIdentifierMethod (const char **identifier);
@@ -159,12 +173,34 @@ typedef struct {
 
 extern const GioClass *const gioClasses[];
 extern const GioClass gioNullClass;
+extern const GioClass gioReplayClass;
 extern const GioClass gioSerialClass;
 extern const GioClass gioUsbClass;
 extern const GioClass gioBluetoothClass;
 
 extern void gioSetBytesPerSecond (GioEndpoint *endpoint, const SerialParameters *parameters);
 
+#define GIO_CAPTURE_MAGIC "BRLTTY-GIO"
+#define GIO_CAPTURE_VERSION 1
+
+typedef struct {
+  unsigned char magic[sizeof(GIO_CAPTURE_MAGIC) - 1];
+  unsigned char version;
+} PACKED GioCaptureFileHeader;
+
+typedef enum {
+  GIO_CAPTURE_CONNECT,
+  GIO_CAPTURE_INPUT,
+  GIO_CAPTURE_OUTPUT
+} GioCaptureRecordType;
+
+typedef struct {
+  unsigned char time[4];
+  unsigned char type;
+  unsigned char endpoint;
+  unsigned char size[2];
+} PACKED GioCaptureRecordHeader;
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,210 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2017 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://brltty.com/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "io_generic.h"
+#include "gio_internal.h"
+#include "async_wait.h"
+#include "device.h"
+
+struct GioHandleStruct {
+  FILE *file;
+  int endpoint;
+  size_t remaining;
+
+  unsigned long int outputExpected;
+  unsigned long int outputWritten;
+};
+
+static int
+getNextReplayInput (GioHandle *handle) {
+  while (!handle->remaining) {
+    GioCaptureRecordHeader header;
+    size_t size;
+
+    if (fread(&header, 1, sizeof(header), handle->file) != sizeof(header)) {
+      if (ferror(handle->file)) logSystemError("fread");
+      return 0;
+    }
+
+    size = header.size[0] | (header.size[1] << 8);
+    if (handle->endpoint < 0) handle->endpoint = header.endpoint;
+
+    if (header.endpoint == handle->endpoint) {
+      if (header.type == GIO_CAPTURE_INPUT) {
+        handle->remaining = size;
+        continue;
+      }
+
+      if (header.type == GIO_CAPTURE_OUTPUT) handle->outputExpected += size;
+    }
+
+    if (fseek(handle->file, size, SEEK_CUR) == -1) {
+      logSystemError("fseek");
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+isReplayInputAvailable (GioHandle *handle) {
+  if (!getNextReplayInput(handle)) return 0;
+
+  /* Input is only released once the driver has written as much as was
+   * written before it when the capture was made. This keeps the replay
+   * in step with the driver's requests - in particular, it isn't all
+   * thrown away by the discard which follows connecting.
+   */
+  return handle->outputWritten >= handle->outputExpected;
+}
+
+static int
+disconnectReplayResource (GioHandle *handle) {
+  fclose(handle->file);
+  free(handle);
+  return 1;
+}
+
+static ssize_t
+writeReplayData (GioHandle *handle, const void *data, size_t size, int timeout) {
+  handle->outputWritten += size;
+  return size;
+}
+
+static int
+awaitReplayInput (GioHandle *handle, int timeout) {
+  if (isReplayInputAvailable(handle)) return 1;
+
+  asyncWait(timeout);
+  errno = EAGAIN;
+  return 0;
+}
+
+static ssize_t
+readReplayData (
+  GioHandle *handle, void *buffer, size_t size,
+  int initialTimeout, int subsequentTimeout
+) {
+  if (!isReplayInputAvailable(handle)) {
+    if (!initialTimeout) return 0;
+    if (!awaitReplayInput(handle, initialTimeout)) return 0;
+  }
+
+  if (size > handle->remaining) size = handle->remaining;
+
+  if (fread(buffer, 1, size, handle->file) != size) {
+    if (ferror(handle->file)) {
+      logSystemError("fread");
+      return -1;
+    }
+
+    handle->remaining = 0;
+    return 0;
+  }
+
+  handle->remaining -= size;
+  return size;
+}
+
+static const GioMethods gioReplayMethods = {
+  .disconnectResource = disconnectReplayResource,
+
+  .writeData = writeReplayData,
+  .awaitInput = awaitReplayInput,
+  .readData = readReplayData
+};
+
+static int
+isReplaySupported (const GioDescriptor *descriptor) {
+  return 1;
+}
+
+static int
+testReplayIdentifier (const char **identifier) {
+  return isQualifiedDevice(identifier, "replay");
+}
+
+static const GioOptions *
+getReplayOptions (const GioDescriptor *descriptor) {
+  if (descriptor->serial.parameters) return &descriptor->serial.options;
+  if (descriptor->usb.channelDefinitions) return &descriptor->usb.options;
+  return &descriptor->null.options;
+}
+
+static const GioMethods *
+getReplayMethods (void) {
+  return &gioReplayMethods;
+}
+
+static GioHandle *
+connectReplayResource (
+  const char *identifier,
+  const GioDescriptor *descriptor
+) {
+  GioHandle *handle = malloc(sizeof(*handle));
+
+  if (handle) {
+    memset(handle, 0, sizeof(*handle));
+    handle->endpoint = -1;
+    handle->remaining = 0;
+    handle->outputExpected = 0;
+    handle->outputWritten = 0;
+
+    if ((handle->file = fopen(identifier, "rb"))) {
+      GioCaptureFileHeader header;
+
+      if ((fread(&header, 1, sizeof(header), handle->file) == sizeof(header)) &&
+          (memcmp(header.magic, GIO_CAPTURE_MAGIC, sizeof(header.magic)) == 0) &&
+          (header.version == GIO_CAPTURE_VERSION)) {
+        return handle;
+      }
+
+      logMessage(LOG_WARNING, "not a generic I/O capture file: %s", identifier);
+      fclose(handle->file);
+    } else {
+      logMessage(LOG_WARNING, "cannot open generic I/O capture file: %s: %s",
+                 identifier, strerror(errno));
+    }
+
+    free(handle);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+const GioClass gioReplayClass = {
+  .isSupported = isReplaySupported,
+  .testIdentifier = testReplayIdentifier,
+
+  .getOptions = getReplayOptions,
+  .getMethods = getReplayMethods,
+
+  .connectResource = connectReplayResource,
+
+  .resourceType = GIO_RESOURCE_REPLAY
+};
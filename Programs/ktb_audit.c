@@ -138,6 +138,32 @@ static KEY_TABLE_AUDITOR(reportDuplicateKeyBindings) {
   return ok;
 }
 
+static KEY_TABLE_AUDITOR(reportShadowedKeyBindings) {
+  int ok = 1;
+  const KeyBinding *binding = kta->ctx->keyBindings.table;
+  const KeyBinding *end = binding + kta->ctx->keyBindings.count;
+
+  while (binding < end) {
+    if ((binding->flags & KBF_SHADOWED) && (binding->primaryCommand.value != EOF)) {
+      ok = 0;
+
+      char audit[0X100];
+      STR_BEGIN(audit, sizeof(audit));
+
+      STR_FORMAT(formatKeyTableAuditPrefix, kta, "key binding shadowed by hotkey");
+      STR_PRINTF(": ");
+      STR_FORMAT(formatKeyCombination, kta->table, &binding->keyCombination);
+
+      STR_END;
+      reportKeyTableAudit(audit);
+    }
+
+    binding += 1;
+  }
+
+  return ok;
+}
+
 static void
 reportKeyProblem (const KeyTableAuditorParameters *kta, const KeyValue *key, const char *problem) {
   char audit[0X100];
@@ -208,6 +234,7 @@ auditKeyTable (KeyTable *table, const char *path) {
       static KeyTableAuditor *const auditors[] = {
         reportKeyContextProblems,
         reportDuplicateKeyBindings,
+        reportShadowedKeyBindings,
         reportDuplicateHotkeys,
         reportDuplicateMappedKeys,
         NULL
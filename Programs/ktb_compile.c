@@ -20,6 +20,7 @@
 
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include "log.h"
 #include "file.h"
@@ -189,14 +190,19 @@ getKeyContext (KeyTableData *ktd, unsigned char context) {
       ctx->keyBindings.size = 0;
       ctx->keyBindings.count = 0;
       ctx->keyBindings.sorted = NULL;
+      initializeKeyHash(&ctx->keyBindings.hash);
+      BITMASK_ZERO(ctx->keyBindings.anyKeyGroups);
+      ctx->keyBindings.anyKeyMaximum = 0;
 
       ctx->hotkeys.table = NULL;
       ctx->hotkeys.count = 0;
       ctx->hotkeys.sorted = NULL;
+      initializeKeyHash(&ctx->hotkeys.hash);
 
       ctx->mappedKeys.table = NULL;
       ctx->mappedKeys.count = 0;
       ctx->mappedKeys.sorted = NULL;
+      initializeKeyHash(&ctx->mappedKeys.hash);
       ctx->mappedKeys.superimpose = 0;
     }
   }
@@ -1235,6 +1241,269 @@ compareKeyBindings (const KeyBinding *binding1, const KeyBinding *binding2) {
   return compareKeyCombinations(&binding1->keyCombination, &binding2->keyCombination);
 }
 
+#define KEY_HASH_ATTEMPT_LIMIT 0X10
+
+static inline uint32_t
+mixKeyHash (uint32_t hash) {
+  hash ^= hash >> 16;
+  hash *= 0X85EBCA6B;
+  hash ^= hash >> 13;
+  hash *= 0XC2B2AE35;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+static inline uint32_t
+addKeyValueToHash (uint32_t hash, const KeyValue *value) {
+  return mixKeyHash(hash + ((value->group << 8) | value->number) + 1);
+}
+
+static uint32_t
+hashKeyBinding (const void *item, uint32_t seed) {
+  const KeyBinding *binding = item;
+  const KeyCombination *combination = &binding->keyCombination;
+  uint32_t hash = mixKeyHash(seed ^ 0X9E3779B9);
+
+  if (combination->flags & KCF_IMMEDIATE_KEY) {
+    hash = addKeyValueToHash(hash, &combination->immediateKey);
+  }
+
+  for (unsigned int index=0; index<combination->modifierCount; index+=1) {
+    hash = addKeyValueToHash(hash, &combination->modifierKeys[index]);
+  }
+
+  return mixKeyHash(hash ^ ((combination->flags & KCF_IMMEDIATE_KEY) << 16) ^ combination->modifierCount);
+}
+
+static uint32_t
+hashHotkeyEntry (const void *item, uint32_t seed) {
+  const HotkeyEntry *hotkey = item;
+  return addKeyValueToHash(mixKeyHash(seed ^ 0X9E3779B9), &hotkey->keyValue);
+}
+
+static uint32_t
+hashMappedKeyEntry (const void *item, uint32_t seed) {
+  const MappedKeyEntry *map = item;
+  return addKeyValueToHash(mixKeyHash(seed ^ 0X9E3779B9), &map->keyValue);
+}
+
+void
+initializeKeyHash (KeyHash *hash) {
+  hash->indexes = NULL;
+  hash->displacements = NULL;
+  hash->size = 0;
+  hash->buckets = 0;
+  hash->seed = 0;
+}
+
+void
+destroyKeyHash (KeyHash *hash) {
+  if (hash->indexes) free(hash->indexes);
+  if (hash->displacements) free(hash->displacements);
+  initializeKeyHash(hash);
+}
+
+static inline unsigned int
+getKeyHashBucket (const KeyHash *hash, KeyHashFunction *function, const void *item) {
+  return function(item, hash->seed) % hash->buckets;
+}
+
+static inline unsigned int
+getKeyHashSlot (const KeyHash *hash, KeyHashFunction *function, const void *item, unsigned int displacement) {
+  return function(item, hash->seed + 1 + displacement) % hash->size;
+}
+
+static int
+getKeyHashIndex (const KeyHash *hash, KeyHashFunction *function, const void *item, unsigned int *index) {
+  if (!hash->size) return 0;
+
+  {
+    unsigned int bucket = getKeyHashBucket(hash, function, item);
+    unsigned int slot = getKeyHashSlot(hash, function, item, hash->displacements[bucket]);
+
+    *index = hash->indexes[slot];
+    return 1;
+  }
+}
+
+const KeyBinding *
+getKeyBinding (const KeyContext *ctx, const KeyBinding *target) {
+  unsigned int index;
+
+  if (getKeyHashIndex(&ctx->keyBindings.hash, hashKeyBinding, target, &index)) {
+    const KeyBinding *binding = &ctx->keyBindings.table[index];
+    if (compareKeyBindings(target, binding) == 0) return binding;
+  }
+
+  return NULL;
+}
+
+const HotkeyEntry *
+getHotkeyEntry (const KeyContext *ctx, const KeyValue *keyValue) {
+  const HotkeyEntry target = {
+    .keyValue = *keyValue
+  };
+
+  unsigned int index;
+
+  if (getKeyHashIndex(&ctx->hotkeys.hash, hashHotkeyEntry, &target, &index)) {
+    const HotkeyEntry *hotkey = &ctx->hotkeys.table[index];
+    if (compareKeyValues(keyValue, &hotkey->keyValue) == 0) return hotkey;
+  }
+
+  return NULL;
+}
+
+const MappedKeyEntry *
+getMappedKeyEntry (const KeyContext *ctx, const KeyValue *keyValue) {
+  const MappedKeyEntry target = {
+    .keyValue = *keyValue
+  };
+
+  unsigned int index;
+
+  if (getKeyHashIndex(&ctx->mappedKeys.hash, hashMappedKeyEntry, &target, &index)) {
+    const MappedKeyEntry *map = &ctx->mappedKeys.table[index];
+    if (compareKeyValues(keyValue, &map->keyValue) == 0) return map;
+  }
+
+  return NULL;
+}
+
+typedef struct {
+  unsigned int bucket;
+  unsigned int count;
+} KeyHashBucketEntry;
+
+static int
+sortKeyHashBuckets (const void *element1, const void *element2) {
+  const KeyHashBucketEntry *bucket1 = element1;
+  const KeyHashBucketEntry *bucket2 = element2;
+
+  if (bucket1->count > bucket2->count) return -1;
+  if (bucket1->count < bucket2->count) return 1;
+  if (bucket1->bucket < bucket2->bucket) return -1;
+  if (bucket1->bucket > bucket2->bucket) return 1;
+  return 0;
+}
+
+static int
+placeKeyHashItems (
+  KeyHash *hash, KeyHashFunction *function,
+  const unsigned char *table, size_t itemSize,
+  const unsigned int *indexes, unsigned int count,
+  KeyHashBucketEntry *buckets, unsigned int *starts,
+  unsigned int *members, unsigned int *slots
+) {
+  const unsigned int unused = UINT_MAX;
+
+  for (unsigned int bucket=0; bucket<hash->buckets; bucket+=1) {
+    buckets[bucket].bucket = bucket;
+    buckets[bucket].count = 0;
+    hash->displacements[bucket] = 0;
+  }
+
+  for (unsigned int item=0; item<count; item+=1) {
+    buckets[getKeyHashBucket(hash, function, &table[indexes[item] * itemSize])].count += 1;
+  }
+
+  {
+    unsigned int end = 0;
+
+    for (unsigned int bucket=0; bucket<hash->buckets; bucket+=1) {
+      end += buckets[bucket].count;
+      starts[bucket] = end;
+    }
+  }
+
+  for (unsigned int item=0; item<count; item+=1) {
+    unsigned int bucket = getKeyHashBucket(hash, function, &table[indexes[item] * itemSize]);
+    members[--starts[bucket]] = indexes[item];
+  }
+
+  for (unsigned int slot=0; slot<hash->size; slot+=1) {
+    hash->indexes[slot] = unused;
+  }
+
+  /* Place the largest buckets first - they're the hardest to fit. */
+  qsort(buckets, hash->buckets, sizeof(*buckets), sortKeyHashBuckets);
+
+  for (unsigned int entry=0; entry<hash->buckets; entry+=1) {
+    const KeyHashBucketEntry *bucket = &buckets[entry];
+    const unsigned int *member = &members[starts[bucket->bucket]];
+    unsigned int displacement = 0;
+
+    if (!bucket->count) break;
+
+    while (1) {
+      unsigned int index;
+
+      for (index=0; index<bucket->count; index+=1) {
+        unsigned int slot = getKeyHashSlot(hash, function, &table[member[index] * itemSize], displacement);
+        unsigned int previous;
+
+        if (hash->indexes[slot] != unused) break;
+
+        for (previous=0; previous<index; previous+=1) {
+          if (slots[previous] == slot) break;
+        }
+
+        if (previous < index) break;
+        slots[index] = slot;
+      }
+
+      if (index == bucket->count) break;
+      if (++displacement > UINT16_MAX) return 0;
+    }
+
+    for (unsigned int index=0; index<bucket->count; index+=1) {
+      hash->indexes[slots[index]] = member[index];
+    }
+
+    hash->displacements[bucket->bucket] = displacement;
+  }
+
+  return 1;
+}
+
+static int
+makeKeyHash (
+  KeyHash *hash, KeyHashFunction *function,
+  const void *table, size_t itemSize,
+  const unsigned int *indexes, unsigned int count
+) {
+  if (!count) return 1;
+  hash->size = count;
+  hash->buckets = (count + 3) / 4;
+
+  if ((hash->indexes = malloc(ARRAY_SIZE(hash->indexes, hash->size)))) {
+    if ((hash->displacements = malloc(ARRAY_SIZE(hash->displacements, hash->buckets)))) {
+      KeyHashBucketEntry buckets[hash->buckets];
+      unsigned int starts[hash->buckets];
+      unsigned int members[count];
+      unsigned int slots[count];
+
+      for (unsigned int attempt=0; attempt<KEY_HASH_ATTEMPT_LIMIT; attempt+=1) {
+        hash->seed = attempt << 17;
+
+        if (placeKeyHashItems(hash, function, table, itemSize, indexes, count,
+                              buckets, starts, members, slots)) {
+          return 1;
+        }
+      }
+
+      logMessage(LOG_ERR, "key hash not constructed: %u items", count);
+    } else {
+      logMallocError();
+    }
+  } else {
+    logMallocError();
+  }
+
+  destroyKeyHash(hash);
+  return 0;
+}
+
 static int
 sortKeyBindings (const void *element1, const void *element2) {
   const KeyBinding *const *binding1 = element1;
@@ -1492,6 +1761,127 @@ prepareMappedKeyEntries (KeyContext *ctx) {
   return 1;
 }
 
+static int
+makeKeyBindingHash (KeyContext *ctx) {
+  unsigned int count = ctx->keyBindings.count;
+  if (!count) return 1;
+
+  {
+    unsigned int indexes[count];
+    unsigned int unique = 0;
+
+    for (unsigned int index=0; index<count; index+=1) {
+      const KeyBinding *binding = ctx->keyBindings.sorted[index];
+
+      if (index && (compareKeyBindings(binding, ctx->keyBindings.sorted[index-1]) == 0)) continue;
+      indexes[unique++] = binding - ctx->keyBindings.table;
+    }
+
+    return makeKeyHash(&ctx->keyBindings.hash, hashKeyBinding,
+                       ctx->keyBindings.table, sizeof(*ctx->keyBindings.table),
+                       indexes, unique);
+  }
+}
+
+static int
+makeHotkeyHash (KeyContext *ctx) {
+  unsigned int count = ctx->hotkeys.count;
+  if (!count) return 1;
+
+  {
+    unsigned int indexes[count];
+    unsigned int unique = 0;
+
+    for (unsigned int index=0; index<count; index+=1) {
+      const HotkeyEntry *hotkey = ctx->hotkeys.sorted[index];
+
+      if (index && (compareKeyValues(&hotkey->keyValue, &ctx->hotkeys.sorted[index-1]->keyValue) == 0)) continue;
+      indexes[unique++] = hotkey - ctx->hotkeys.table;
+    }
+
+    return makeKeyHash(&ctx->hotkeys.hash, hashHotkeyEntry,
+                       ctx->hotkeys.table, sizeof(*ctx->hotkeys.table),
+                       indexes, unique);
+  }
+}
+
+static int
+makeMappedKeyHash (KeyContext *ctx) {
+  unsigned int count = ctx->mappedKeys.count;
+  if (!count) return 1;
+
+  {
+    unsigned int indexes[count];
+    unsigned int unique = 0;
+
+    for (unsigned int index=0; index<count; index+=1) {
+      const MappedKeyEntry *map = ctx->mappedKeys.sorted[index];
+
+      if (index && (compareKeyValues(&map->keyValue, &ctx->mappedKeys.sorted[index-1]->keyValue) == 0)) continue;
+      indexes[unique++] = map - ctx->mappedKeys.table;
+    }
+
+    return makeKeyHash(&ctx->mappedKeys.hash, hashMappedKeyEntry,
+                       ctx->mappedKeys.table, sizeof(*ctx->mappedKeys.table),
+                       indexes, unique);
+  }
+}
+
+static int
+isHotkey (const KeyContext *ctx, const KeyValue *keyValue) {
+  if (getHotkeyEntry(ctx, keyValue)) return 1;
+
+  {
+    const KeyValue anyKey = {
+      .group = keyValue->group,
+      .number = KTB_KEY_ANY
+    };
+
+    return !!getHotkeyEntry(ctx, &anyKey);
+  }
+}
+
+static void
+finalizeKeyBinding (KeyContext *ctx, KeyBinding *binding) {
+  const KeyCombination *combination = &binding->keyCombination;
+  unsigned char anyKeyCount = 0;
+
+  for (unsigned int index=0; index<combination->modifierCount; index+=1) {
+    const KeyValue *modifier = &combination->modifierKeys[index];
+
+    if (modifier->number == KTB_KEY_ANY) {
+      BITMASK_SET(ctx->keyBindings.anyKeyGroups, modifier->group);
+      anyKeyCount += 1;
+    }
+
+    /* A hotkey is handled as soon as it's pressed and is never added to the
+     * set of pressed keys, so a binding which includes it can't be reached.
+     */
+    if (isHotkey(ctx, modifier)) binding->flags |= KBF_SHADOWED;
+  }
+
+  if (combination->flags & KCF_IMMEDIATE_KEY) {
+    if (isHotkey(ctx, &combination->immediateKey)) binding->flags |= KBF_SHADOWED;
+  }
+
+  if (anyKeyCount > ctx->keyBindings.anyKeyMaximum) {
+    ctx->keyBindings.anyKeyMaximum = anyKeyCount;
+  }
+}
+
+static int
+finalizeKeyContext (KeyContext *ctx) {
+  if (!makeHotkeyHash(ctx)) return 0;
+  if (!makeMappedKeyHash(ctx)) return 0;
+  if (!makeKeyBindingHash(ctx)) return 0;
+
+  for (unsigned int index=0; index<ctx->keyBindings.count; index+=1) {
+    finalizeKeyBinding(ctx, &ctx->keyBindings.table[index]);
+  }
+
+  return 1;
+}
+
 int
 finishKeyTable (KeyTableData *ktd) {
   for (unsigned int context=0; context<ktd->table->keyContexts.count; context+=1) {
@@ -1500,6 +1890,7 @@ finishKeyTable (KeyTableData *ktd) {
     if (!prepareKeyBindings(ctx)) return 0;
     if (!prepareHotkeyEntries(ctx)) return 0;
     if (!prepareMappedKeyEntries(ctx)) return 0;
+    if (!finalizeKeyContext(ctx)) return 0;
   }
 
   qsort(ktd->table->keyNames.table, ktd->table->keyNames.count, sizeof(*ktd->table->keyNames.table), sortKeyValues);
@@ -1644,12 +2035,15 @@ destroyKeyTable (KeyTable *table) {
 
     if (ctx->keyBindings.table) free(ctx->keyBindings.table);
     if (ctx->keyBindings.sorted) free(ctx->keyBindings.sorted);
+    destroyKeyHash(&ctx->keyBindings.hash);
 
     if (ctx->hotkeys.table) free(ctx->hotkeys.table);
     if (ctx->hotkeys.sorted) free(ctx->hotkeys.sorted);
+    destroyKeyHash(&ctx->hotkeys.hash);
 
     if (ctx->mappedKeys.table) free(ctx->mappedKeys.table);
     if (ctx->mappedKeys.sorted) free(ctx->mappedKeys.sorted);
+    destroyKeyHash(&ctx->mappedKeys.hash);
   }
 
   if (table->keyContexts.table) free(table->keyContexts.table);
@@ -22,6 +22,7 @@
 #include "strfmth.h"
 #include "cmd_types.h"
 #include "async.h"
+#include "bitmask.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,6 +58,7 @@ typedef struct {
 
 typedef enum {
   KBF_HIDDEN   = 0X01,
+  KBF_SHADOWED = 0X02,
 } KeyBindingFlag;
 
 typedef struct {
@@ -87,6 +89,16 @@ typedef struct {
   unsigned char flags;
 } MappedKeyEntry;
 
+typedef uint32_t KeyHashFunction (const void *item, uint32_t seed);
+
+typedef struct {
+  unsigned int *indexes;
+  uint16_t *displacements;
+  unsigned int size;
+  unsigned int buckets;
+  uint32_t seed;
+} KeyHash;
+
 typedef struct {
   wchar_t *name;
   wchar_t *title;
@@ -100,18 +112,24 @@ typedef struct {
     unsigned int size;
     unsigned int count;
     const KeyBinding **sorted;
+    KeyHash hash;
+
+    BITMASK(anyKeyGroups, 0X100, char);
+    unsigned char anyKeyMaximum;
   } keyBindings;
 
   struct {
     HotkeyEntry *table;
     unsigned int count;
     const HotkeyEntry **sorted;
+    KeyHash hash;
   } hotkeys;
 
   struct {
     MappedKeyEntry *table;
     unsigned int count;
     const MappedKeyEntry **sorted;
+    KeyHash hash;
     int superimpose;
   } mappedKeys;
 } KeyContext;
@@ -191,6 +209,13 @@ extern int deleteKeyValue (KeyValue *values, unsigned int *count, const KeyValue
 
 extern int compareKeyBindings (const KeyBinding *binding1, const KeyBinding *binding2);
 
+extern void initializeKeyHash (KeyHash *hash);
+extern void destroyKeyHash (KeyHash *hash);
+
+extern const KeyBinding *getKeyBinding (const KeyContext *ctx, const KeyBinding *target);
+extern const HotkeyEntry *getHotkeyEntry (const KeyContext *ctx, const KeyValue *keyValue);
+extern const MappedKeyEntry *getMappedKeyEntry (const KeyContext *ctx, const KeyValue *keyValue);
+
 extern STR_DECLARE_FORMATTER(formatKeyName, KeyTable *table, const KeyValue *value);
 
 extern void resetLongPressData (KeyTable *table);
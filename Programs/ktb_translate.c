@@ -87,26 +87,56 @@ setKeyAutoreleaseTime (KeyTable *table, unsigned char setting) {
   setAutoreleaseAlarm(table);
 }
 
-static int
-sortModifierKeys (const void *element1, const void *element2) {
-  const KeyValue *modifier1 = element1;
-  const KeyValue *modifier2 = element2;
-  return compareKeyValues(modifier1, modifier2);
+static unsigned int
+getAnyKeyCandidates (const KeyTable *table, const KeyContext *ctx) {
+  unsigned int candidates = 0;
+  unsigned int index;
+
+  for (index=0; index<table->pressedKeys.count; index+=1) {
+    if (BITMASK_TEST(ctx->keyBindings.anyKeyGroups, table->pressedKeys.table[index].group)) {
+      candidates |= 1 << index;
+    }
+  }
+
+  return candidates;
 }
 
-static int
-searchKeyBinding (const void *target, const void *element) {
-  const KeyBinding *reference = target;
-  const KeyBinding *const *binding = element;
-  return compareKeyBindings(reference, *binding);
+static void
+setModifierKeys (KeyCombination *combination, const KeyValue *keys, unsigned int count, unsigned int anyKeys) {
+  KeyValue *modifier = combination->modifierKeys;
+  unsigned int index = 0;
+
+  /* The pressed keys are sorted, and KTB_KEY_ANY sorts after every other
+   * key number, so the wildcards of each group go at the end of that group.
+   */
+  while (index < count) {
+    const KeyGroup group = keys[index].group;
+    unsigned int anyCount = 0;
+
+    do {
+      if (anyKeys & (1 << index)) {
+        anyCount += 1;
+      } else {
+        *modifier++ = keys[index];
+      }
+    } while ((++index < count) && (keys[index].group == group));
+
+    while (anyCount) {
+      modifier->group = group;
+      modifier->number = KTB_KEY_ANY;
+      modifier += 1;
+      anyCount -= 1;
+    }
+  }
 }
 
 static const KeyBinding *
 findKeyBinding (KeyTable *table, unsigned char context, const KeyValue *immediate, int *isIncomplete) {
   const KeyContext *ctx = getKeyContext(table, context);
 
-  if (ctx && ctx->keyBindings.sorted &&
+  if (ctx && ctx->keyBindings.hash.size &&
       (table->pressedKeys.count <= MAX_MODIFIERS_PER_COMBINATION)) {
+    const unsigned int candidates = getAnyKeyCandidates(table, ctx);
     KeyBinding target;
     memset(&target, 0, sizeof(target));
 
@@ -117,32 +147,21 @@ findKeyBinding (KeyTable *table, unsigned char context, const KeyValue *immediat
     target.keyCombination.modifierCount = table->pressedKeys.count;
 
     while (1) {
-      unsigned int all = (1 << table->pressedKeys.count) - 1;
-      unsigned int bits;
-
-      for (bits=0; bits<=all; bits+=1) {
-        {
-          unsigned int index;
-          unsigned int bit;
-
-          for (index=0, bit=1; index<table->pressedKeys.count; index+=1, bit<<=1) {
-            KeyValue *modifier = &target.keyCombination.modifierKeys[index];
+      unsigned int anyKeys = 0;
 
-            *modifier = table->pressedKeys.table[index];
-            if (bits & bit) modifier->number = KTB_KEY_ANY;
-          }
-        }
-        qsort(target.keyCombination.modifierKeys, table->pressedKeys.count, sizeof(*target.keyCombination.modifierKeys), sortModifierKeys);
+      /* Visit the subsets of the wildcard candidates in ascending order. */
+      do {
+        if (popcount(anyKeys) <= ctx->keyBindings.anyKeyMaximum) {
+          const KeyBinding *binding;
 
-        {
-          const KeyBinding *const *binding = bsearch(&target, ctx->keyBindings.sorted, ctx->keyBindings.count, sizeof(*ctx->keyBindings.sorted), searchKeyBinding);
+          setModifierKeys(&target.keyCombination, table->pressedKeys.table, table->pressedKeys.count, anyKeys);
 
-          if (binding) {
-            if ((*binding)->primaryCommand.value != EOF) return *binding;
+          if ((binding = getKeyBinding(ctx, &target))) {
+            if (binding->primaryCommand.value != EOF) return binding;
             *isIncomplete = 1;
           }
         }
-      }
+      } while ((anyKeys = (anyKeys - candidates) & candidates));
 
       if (!(target.keyCombination.flags & KCF_IMMEDIATE_KEY)) break;
       if (target.keyCombination.immediateKey.number == KTB_KEY_ANY) break;
@@ -153,51 +172,11 @@ findKeyBinding (KeyTable *table, unsigned char context, const KeyValue *immediat
   return NULL;
 }
 
-static int
-searchHotkeyEntry (const void *target, const void *element) {
-  const HotkeyEntry *reference = target;
-  const HotkeyEntry *const *hotkey = element;
-  return compareKeyValues(&reference->keyValue, &(*hotkey)->keyValue);
-}
-
 static const HotkeyEntry *
 findHotkeyEntry (KeyTable *table, unsigned char context, const KeyValue *keyValue) {
   const KeyContext *ctx = getKeyContext(table, context);
 
-  if (ctx && ctx->hotkeys.sorted) {
-    HotkeyEntry target = {
-      .keyValue = *keyValue
-    };
-
-    {
-      const HotkeyEntry *const *hotkey = bsearch(&target, ctx->hotkeys.sorted, ctx->hotkeys.count, sizeof(*ctx->hotkeys.sorted), searchHotkeyEntry);
-      if (hotkey) return *hotkey;
-    }
-  }
-
-  return NULL;
-}
-
-static int
-searchMappedKeyEntry (const void *target, const void *element) {
-  const MappedKeyEntry *reference = target;
-  const MappedKeyEntry *const *map = element;
-  return compareKeyValues(&reference->keyValue, &(*map)->keyValue);
-}
-
-static const MappedKeyEntry *
-findMappedKeyEntry (const KeyContext *ctx, const KeyValue *keyValue) {
-  if (ctx->mappedKeys.sorted) {
-    MappedKeyEntry target = {
-      .keyValue = *keyValue
-    };
-
-    {
-      const MappedKeyEntry *const *map = bsearch(&target, ctx->mappedKeys.sorted, ctx->mappedKeys.count, sizeof(*ctx->mappedKeys.sorted), searchMappedKeyEntry);
-      if (map) return *map;
-    }
-  }
-
+  if (ctx) return getHotkeyEntry(ctx, keyValue);
   return NULL;
 }
 
@@ -210,7 +189,7 @@ makeKeyboardCommand (KeyTable *table, unsigned char context, int allowChords) {
 
     for (unsigned int pressedIndex=0; pressedIndex<table->pressedKeys.count; pressedIndex+=1) {
       const KeyValue *keyValue = &table->pressedKeys.table[pressedIndex];
-      const MappedKeyEntry *map = findMappedKeyEntry(ctx, keyValue);
+      const MappedKeyEntry *map = getMappedKeyEntry(ctx, keyValue);
 
       if (!map) return EOF;
       bits |= map->keyboardFunction->bit;
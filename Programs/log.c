@@ -36,6 +36,7 @@
 #include "addresses.h"
 #include "stdiox.h"
 #include "thread.h"
+#include "parameters.h"
 
 const char logCategoryName_all[] = "all";
 const char logCategoryPrefix_disable = '-';
@@ -267,9 +268,202 @@ popLogPrefix (void) {
   return popLogEntry(&logPrefixStack);
 }
 
+#ifdef GOT_PTHREADS
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t bufferMutex;
+  pthread_mutex_t outputMutex;
+  pthread_cond_t recordsAdded;
+  unsigned char stop;
+
+  unsigned long int head;
+  unsigned long int tail;
+  unsigned long int dropped;
+  char data[LOG_FILE_BUFFER_SIZE];
+} LogFileBuffer;
+
+static LogFileBuffer *logFileBuffer = NULL;
+
+static void
+forgetLogFileBuffer (void) {
+  /* A forked child has the parent's buffer but not its writer thread.
+   * The parent still owns (and will write) what's in it, so the child
+   * just goes back to writing its own records directly.
+   */
+  logFileBuffer = NULL;
+}
+
+static int
+appendLogFileBuffer (const char *line, size_t length) {
+  LogFileBuffer *lfb = logFileBuffer;
+  int appended = 0;
+
+  pthread_mutex_lock(&lfb->bufferMutex);
+    if (length > (sizeof(lfb->data) - (lfb->head - lfb->tail))) {
+      lfb->dropped += 1;
+    } else {
+      size_t index = lfb->head % sizeof(lfb->data);
+      size_t count = MIN(length, sizeof(lfb->data)-index);
+
+      memcpy(&lfb->data[index], line, count);
+      memcpy(lfb->data, &line[count], length-count);
+      lfb->head += length;
+      appended = 1;
+    }
+
+    pthread_cond_signal(&lfb->recordsAdded);
+  pthread_mutex_unlock(&lfb->bufferMutex);
+
+  return appended;
+}
+
+static void
+drainLogFileBuffer (void) {
+  LogFileBuffer *lfb = logFileBuffer;
+  unsigned long int from;
+  unsigned long int to;
+  unsigned long int dropped;
+
+  /* Only the writer of the pending records holds the output mutex, so
+   * the buffer lock is held just long enough to snapshot the bounds and
+   * records can still be appended while the file is being written.
+   */
+  pthread_mutex_lock(&lfb->outputMutex);
+    pthread_mutex_lock(&lfb->bufferMutex);
+      from = lfb->tail;
+      to = lfb->head;
+      dropped = lfb->dropped;
+      lfb->dropped = 0;
+    pthread_mutex_unlock(&lfb->bufferMutex);
+
+    lockStream(logFile);
+      while (from < to) {
+        size_t index = from % sizeof(lfb->data);
+        size_t count = MIN(to-from, sizeof(lfb->data)-index);
+
+        fwrite(&lfb->data[index], 1, count, logFile);
+        from += count;
+      }
+
+      if (dropped) fprintf(logFile, "%lu log records dropped\n", dropped);
+      flushStream(logFile);
+    unlockStream(logFile);
+
+    pthread_mutex_lock(&lfb->bufferMutex);
+      lfb->tail = to;
+    pthread_mutex_unlock(&lfb->bufferMutex);
+  pthread_mutex_unlock(&lfb->outputMutex);
+}
+
+THREAD_FUNCTION(runLogFileWriter) {
+  LogFileBuffer *lfb = argument;
+
+  pthread_mutex_lock(&lfb->bufferMutex);
+
+  while (1) {
+    if ((lfb->head == lfb->tail) && !lfb->dropped) {
+      if (lfb->stop) break;
+      pthread_cond_wait(&lfb->recordsAdded, &lfb->bufferMutex);
+      continue;
+    }
+
+    pthread_mutex_unlock(&lfb->bufferMutex);
+      drainLogFileBuffer();
+    pthread_mutex_lock(&lfb->bufferMutex);
+  }
+
+  pthread_mutex_unlock(&lfb->bufferMutex);
+  return NULL;
+}
+
+static void
+stopLogFileWriter (void) {
+  LogFileBuffer *lfb = logFileBuffer;
+
+  if (lfb) {
+    pthread_mutex_lock(&lfb->bufferMutex);
+      lfb->stop = 1;
+      pthread_cond_signal(&lfb->recordsAdded);
+    pthread_mutex_unlock(&lfb->bufferMutex);
+
+    pthread_join(lfb->thread, NULL);
+    drainLogFileBuffer();
+    logFileBuffer = NULL;
+
+    pthread_cond_destroy(&lfb->recordsAdded);
+    pthread_mutex_destroy(&lfb->outputMutex);
+    pthread_mutex_destroy(&lfb->bufferMutex);
+    free(lfb);
+  }
+}
+#endif /* GOT_PTHREADS */
+
+int
+bufferLogFile (void) {
+#ifdef GOT_PTHREADS
+  if (logFileBuffer) return 1;
+
+  if (logFile) {
+    LogFileBuffer *lfb;
+
+    {
+      static unsigned char atForkRegistered = 0;
+
+      if (!atForkRegistered) {
+        int error = pthread_atfork(NULL, NULL, forgetLogFileBuffer);
+
+        if (error) {
+          logActionError(error, "log file writer fork handler registration");
+          return 0;
+        }
+
+        atForkRegistered = 1;
+      }
+    }
+
+    if ((lfb = malloc(sizeof(*lfb)))) {
+      lfb->head = lfb->tail = 0;
+      lfb->dropped = 0;
+      lfb->stop = 0;
+
+      pthread_mutex_init(&lfb->bufferMutex, NULL);
+      pthread_mutex_init(&lfb->outputMutex, NULL);
+      pthread_cond_init(&lfb->recordsAdded, NULL);
+
+      {
+        int error = createThread("log-file-writer", &lfb->thread, NULL,
+                                 runLogFileWriter, lfb);
+
+        if (!error) {
+          logFileBuffer = lfb;
+          return 1;
+        }
+
+        logActionError(error, "log file writer thread creation");
+      }
+
+      pthread_cond_destroy(&lfb->recordsAdded);
+      pthread_mutex_destroy(&lfb->outputMutex);
+      pthread_mutex_destroy(&lfb->bufferMutex);
+      free(lfb);
+    } else {
+      logMallocError();
+    }
+  }
+#else /* GOT_PTHREADS */
+  logUnsupportedFeature("buffered log file");
+#endif /* GOT_PTHREADS */
+
+  return 0;
+}
+
 void
 closeLogFile (void) {
   if (logFile) {
+#ifdef GOT_PTHREADS
+    stopLogFileWriter();
+#endif /* GOT_PTHREADS */
+
     fclose(logFile);
     logFile = NULL;
   }
@@ -282,9 +476,12 @@ openLogFile (const char *path) {
 }
 
 static void
-writeLogRecord (const char *record) {
+writeLogRecord (int level, const char *record) {
   if (logFile) {
-    lockStream(logFile);
+    char line[0X1100];
+    size_t length;
+
+    STR_BEGIN(line, sizeof(line));
 
     {
       TimeValue now;
@@ -296,18 +493,32 @@ writeLogRecord (const char *record) {
       length = formatSeconds(buffer, sizeof(buffer), "%Y-%m-%d@%H:%M:%S", now.seconds);
       milliseconds = now.nanoseconds / NSECS_PER_MSEC;
 
-      fprintf(logFile, "%.*s.%03u ", (int)length, buffer, milliseconds);
+      STR_PRINTF("%.*s.%03u ", (int)length, buffer, milliseconds);
     }
 
     {
       char name[0X40];
       size_t length = formatThreadName(name, sizeof(name));
 
-      if (length) fprintf(logFile, "[%s] ", name);
+      if (length) STR_PRINTF("[%s] ", name);
+    }
+
+    STR_PRINTF("%s\n", record);
+    length = STR_LENGTH;
+    STR_END;
+
+#ifdef GOT_PTHREADS
+    if (logFileBuffer) {
+      appendLogFileBuffer(line, length);
+
+      /* Don't leave the records that explain a crash in the buffer. */
+      if (level <= LOG_CRIT) drainLogFileBuffer();
+      return;
     }
+#endif /* GOT_PTHREADS */
 
-    fputs(record, logFile);
-    fputc('\n', logFile);
+    lockStream(logFile);
+    fwrite(line, 1, length, logFile);
     flushStream(logFile);
     unlockStream(logFile);
   }
@@ -391,7 +602,7 @@ logData (int level, LogDataFormatter *formatLogData, const void *data) {
       STR_END;
 
       if (write) {
-        writeLogRecord(record);
+        writeLogRecord(level, record);
 
 #if defined(WINDOWS)
         if (windowsEventLog != INVALID_HANDLE_VALUE) {
@@ -23,6 +23,7 @@
 #include "log.h"
 #include "log_history.h"
 #include "timing.h"
+#include "parameters.h"
 
 struct LogEntryStruct {
   struct LogEntryStruct *previous;
@@ -108,20 +109,202 @@ unlockLogMessages (void) {
   leaveCriticalSection(&logMessageLock);
 }
 
-static LogEntry *logMessageStack = NULL;
+/* The message history is a fixed-size arena which is reused from its start
+ * once its end has been reached. Each message is a header followed by its
+ * text, and never straddles the end of the arena. Positions grow without
+ * bound and are reduced modulo the arena size when used, so the retained
+ * messages are always those between the oldest position and the next one.
+ * Messages are numbered from 1, and the index maps each retained number to
+ * its position. When a new message needs the space, or the index is full,
+ * the oldest messages are discarded.
+ */
 
-const LogEntry *
-getNewestLogMessage (int freeze) {
+typedef struct {
+  TimeValue time;
+  unsigned int count;
+  unsigned int length;
+  unsigned char noSquash;
+} LogMessageHeader;
+
+static struct {
+  unsigned long int oldestPosition;
+  unsigned long int nextPosition;
+
+  unsigned int oldestNumber;
+  unsigned int newestNumber;
+
+  unsigned long int positions[LOG_MESSAGE_HISTORY_LIMIT];
+  unsigned char arena[LOG_MESSAGE_HISTORY_SIZE];
+} logMessageHistory = {
+  .oldestNumber = 1,
+  .newestNumber = 0
+};
+
+static inline unsigned char *
+getLogMessageAddress (unsigned long int position) {
+  return &logMessageHistory.arena[position % sizeof(logMessageHistory.arena)];
+}
+
+static inline unsigned long int *
+getLogMessagePosition (unsigned int number) {
+  return &logMessageHistory.positions[number % ARRAY_COUNT(logMessageHistory.positions)];
+}
+
+static inline int
+haveLogMessage (unsigned int number) {
+  return (number >= logMessageHistory.oldestNumber) &&
+         (number <= logMessageHistory.newestNumber);
+}
+
+static void
+getLogMessageHeader (unsigned int number, LogMessageHeader *header) {
+  memcpy(header, getLogMessageAddress(*getLogMessagePosition(number)), sizeof(*header));
+}
+
+static void
+putLogMessageHeader (unsigned int number, const LogMessageHeader *header) {
+  memcpy(getLogMessageAddress(*getLogMessagePosition(number)), header, sizeof(*header));
+}
+
+static void
+discardOldestLogMessage (void) {
+  logMessageHistory.oldestNumber += 1;
+
+  logMessageHistory.oldestPosition =
+    haveLogMessage(logMessageHistory.oldestNumber)?
+    *getLogMessagePosition(logMessageHistory.oldestNumber):
+    logMessageHistory.nextPosition;
+}
+
+static void
+addLogMessage (const char *text) {
+  const size_t arenaSize = sizeof(logMessageHistory.arena);
+
+  LogMessageHeader header = {
+    .count = 1,
+    .length = MIN(strlen(text), (arenaSize - sizeof(header) - 1))
+  };
+
+  size_t size = sizeof(header) + header.length + 1;
+  unsigned long int position = logMessageHistory.nextPosition;
+
+  {
+    size_t offset = position % arenaSize;
+    if ((offset + size) > arenaSize) position += arenaSize - offset;
+  }
+
+  while (haveLogMessage(logMessageHistory.oldestNumber)) {
+    unsigned int count = logMessageHistory.newestNumber - logMessageHistory.oldestNumber + 1;
+
+    if (((position + size - logMessageHistory.oldestPosition) <= arenaSize) &&
+        (count < ARRAY_COUNT(logMessageHistory.positions))) {
+      break;
+    }
+
+    discardOldestLogMessage();
+  }
+
+  {
+    unsigned int number = ++logMessageHistory.newestNumber;
+    unsigned char *address = getLogMessageAddress(position);
+
+    if (number == logMessageHistory.oldestNumber) {
+      logMessageHistory.oldestPosition = position;
+    }
+
+    *getLogMessagePosition(number) = position;
+    getCurrentTime(&header.time);
+    memcpy(address, &header, sizeof(header));
+
+    address += sizeof(header);
+    memcpy(address, text, header.length);
+    address[header.length] = 0;
+  }
+
+  logMessageHistory.nextPosition = position + size;
+}
+
+unsigned int
+getOldestLogMessageNumber (void) {
+  lockLogMessages();
+  unsigned int number = logMessageHistory.oldestNumber;
+  unlockLogMessages();
+  return number;
+}
+
+unsigned int
+getNewestLogMessageNumber (int freeze) {
+  lockLogMessages();
+  unsigned int number = logMessageHistory.newestNumber;
+
+  if (freeze && haveLogMessage(number)) {
+    LogMessageHeader header;
+
+    getLogMessageHeader(number, &header);
+    header.noSquash = 1;
+    putLogMessageHeader(number, &header);
+  }
+
+  unlockLogMessages();
+  return number;
+}
+
+int
+getLogMessage (
+  unsigned int number, char *text, size_t size,
+  TimeValue *time, unsigned int *count
+) {
+  int found = 0;
   lockLogMessages();
-  LogEntry *message = logMessageStack;
-  if (freeze && message) message->noSquash = 1;
+
+  if (haveLogMessage(number)) {
+    LogMessageHeader header;
+
+    getLogMessageHeader(number, &header);
+    if (time) *time = header.time;
+    if (count) *count = header.count;
+
+    if (size) {
+      size_t length = MIN(header.length, size-1);
+
+      memcpy(text, getLogMessageAddress(*getLogMessagePosition(number) + sizeof(header)), length);
+      text[length] = 0;
+    }
+
+    found = 1;
+  }
+
   unlockLogMessages();
-  return message;
+  return found;
 }
 
 void
 pushLogMessage (const char *message) {
   lockLogMessages();
-  pushLogEntry(&logMessageStack, message, (LPO_NOLOG | LPO_SQUASH));
+
+  {
+    unsigned int number = logMessageHistory.newestNumber;
+    int squashed = 0;
+
+    if (haveLogMessage(number)) {
+      LogMessageHeader header;
+
+      getLogMessageHeader(number, &header);
+
+      if (!header.noSquash) {
+        const char *text = (const char *)getLogMessageAddress(*getLogMessagePosition(number) + sizeof(header));
+
+        if (strcmp(text, message) == 0) {
+          header.count += 1;
+          getCurrentTime(&header.time);
+          putLogMessageHeader(number, &header);
+          squashed = 1;
+        }
+      }
+    }
+
+    if (!squashed) addLogMessage(message);
+  }
+
   unlockLogMessages();
 }
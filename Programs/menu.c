@@ -338,6 +338,42 @@ newMenuItem (Menu *menu, unsigned char *setting, const MenuString *name) {
   }
 }
 
+void
+deleteMenuItems (Menu *menu, unsigned int index, unsigned int count) {
+  if (index >= menu->items.count) return;
+  if (count > (menu->items.count - index)) count = menu->items.count - index;
+  if (!count) return;
+
+  {
+    MenuItem *first = getMenuItem(menu, index);
+    MenuItem *end = first + count;
+
+    if (menu->activeItem) {
+      if (menu->activeItem >= end) {
+        menu->activeItem -= count;
+      } else if (menu->activeItem >= first) {
+        menu->activeItem = NULL;
+      }
+    }
+
+    {
+      MenuItem *item = first;
+
+      while (item < end) endMenuItem(item++, 1);
+    }
+
+    memmove(first, end, ((menu->items.count - index - count) * sizeof(*first)));
+    menu->items.count -= count;
+  }
+
+  if (menu->items.index >= (index + count)) {
+    menu->items.index -= count;
+  } else if (menu->items.index >= index) {
+    menu->items.index = index;
+    if ((index == menu->items.count) && index) menu->items.index -= 1;
+  }
+}
+
 void
 setMenuItemTester (MenuItem *item, MenuItemTester *handler) {
   item->test = handler;
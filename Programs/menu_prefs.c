@@ -23,6 +23,7 @@
 
 #include "log.h"
 #include "log_history.h"
+#include "queue.h"
 #include "embed.h"
 #include "revision.h"
 #include "menu.h"
@@ -515,43 +516,120 @@ makeMidiInstrumentMenuStrings (void) {
 #endif /* HAVE_MIDI_SUPPORT */
 
 static Menu *logMessagesMenu = NULL;
-static const LogEntry *newestLogMessage = NULL;
+static unsigned int newestLogMessage = 0;
+static Queue *logMessageItems = NULL;
+
+typedef struct {
+  unsigned int number;
+  char *label;
+  char *comment;
+  char *text;
+} LogMessageItem;
+
+static void
+deallocateLogMessageItem (void *item, void *data) {
+  LogMessageItem *lmi = item;
+
+  if (lmi->label) free(lmi->label);
+  if (lmi->comment) free(lmi->comment);
+  if (lmi->text) free(lmi->text);
+  free(lmi);
+}
 
 static int
-addNewLogMessages (const LogEntry *message) {
-  if (message == newestLogMessage) return 1;
-  if (!addNewLogMessages(getPreviousLogEntry(message))) return 0;
+addLogMessage (unsigned int number) {
+  char text[0X1000];
+  TimeValue time;
+  unsigned int count;
+
+  if (!getLogMessage(number, text, sizeof(text), &time, &count)) return 1;
 
-  MenuString name;
-  const TimeValue *time = getLogEntryTime(message);
-  unsigned int count = getLogEntryCount(message);
+  if (!logMessageItems) {
+    if (!(logMessageItems = newQueue(deallocateLogMessageItem, NULL))) {
+      return 0;
+    }
+  }
 
-  if (time) {
+  LogMessageItem *lmi;
+
+  if (!(lmi = malloc(sizeof(*lmi)))) {
+    logMallocError();
+    return 0;
+  }
+
+  memset(lmi, 0, sizeof(*lmi));
+  lmi->number = number;
+
+  {
     char buffer[0X20];
-    formatSeconds(buffer, sizeof(buffer), "%Y-%m-%d@%H:%M:%S", time->seconds);
-    name.label = strdup(buffer);
-  } else {
-    name.label = NULL;
+    formatSeconds(buffer, sizeof(buffer), "%Y-%m-%d@%H:%M:%S", time.seconds);
+    if (!(lmi->label = strdup(buffer))) goto error;
   }
 
   if (count > 1) {
     char buffer[0X10];
     snprintf(buffer, sizeof(buffer), "(%u)", count);
-    name.comment = strdup(buffer);
-  } else {
-    name.comment = NULL;
+    if (!(lmi->comment = strdup(buffer))) goto error;
   }
 
-  MenuItem *item = newTextMenuItem(logMessagesMenu, &name, getLogEntryText(message));
-  if (!item) return 0;
+  if (!(lmi->text = strdup(text))) goto error;
 
-  newestLogMessage = message;
-  return 1;
+  if (enqueueItem(logMessageItems, lmi)) {
+    MenuString name = {
+      .label = lmi->label,
+      .comment = lmi->comment
+    };
+
+    if (newTextMenuItem(logMessagesMenu, &name, lmi->text)) return 1;
+    deleteItem(logMessageItems, lmi);
+    goto discard;
+  }
+
+error:
+  logMallocError();
+discard:
+  deallocateLogMessageItem(lmi, NULL);
+  return 0;
+}
+
+static void
+removeLogMessages (unsigned int oldest) {
+  unsigned int count = 0;
+
+  if (logMessageItems) {
+    Element *element;
+
+    while ((element = getQueueHead(logMessageItems))) {
+      const LogMessageItem *lmi = getElementItem(element);
+
+      if (lmi->number >= oldest) break;
+      deleteElement(element);
+      count += 1;
+    }
+  }
+
+  /* The first item of the submenu is the one which closes it. */
+  if (count) deleteMenuItems(logMessagesMenu, 1, count);
 }
 
 int
 updateLogMessagesSubmenu (void) {
-  return addNewLogMessages(getNewestLogMessage(1));
+  unsigned int newest = getNewestLogMessageNumber(1);
+  unsigned int number = getOldestLogMessageNumber();
+
+  /* The history only retains the most recent messages, so the items for
+   * those which have since been discarded are removed, and those which
+   * were discarded before they could be added are skipped.
+   */
+  removeLogMessages(number);
+  if (number <= newestLogMessage) number = newestLogMessage + 1;
+
+  while (number <= newest) {
+    if (!addLogMessage(number)) return 0;
+    newestLogMessage = number++;
+  }
+
+  return 1;
 }
 
 static Menu *
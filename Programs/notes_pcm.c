@@ -25,9 +25,18 @@
 #include "log.h"
 #include "pcm.h"
 #include "notes.h"
+#include "parameters.h"
 
 char *opt_pcmDevice;
 
+typedef struct {
+  NoteFrequency frequency;
+  unsigned char volume;
+
+  unsigned char *frames;
+  size_t size;
+} PcmToneCacheEntry;
+
 struct NoteDeviceStruct {
   PcmDevice *pcm;
 
@@ -40,6 +49,12 @@ struct NoteDeviceStruct {
   int blockUsed;
 
   PcmSampleMaker makeSample;
+  int frameSize;
+
+  struct {
+    PcmToneCacheEntry entries[PCM_TONE_CACHE_SIZE];
+    unsigned int next;
+  } toneCache;
 };
 
 static int
@@ -49,22 +64,64 @@ pcmFlushBytes (NoteDevice *device) {
   return ok;
 }
 
+static inline int
+pcmGetFreeFrames (NoteDevice *device) {
+  return (device->blockSize - device->blockUsed) / device->frameSize;
+}
+
+static inline int
+pcmCommitBytes (NoteDevice *device, int count) {
+  device->blockUsed += count;
+  if (device->blockUsed < device->blockSize) return 1;
+  return pcmFlushBytes(device);
+}
+
+static inline void
+pcmMakeFrame (NoteDevice *device, unsigned char *frame, int16_t amplitude) {
+  PcmSampleSize size = device->makeSample((PcmSample *)frame, amplitude);
+
+  /* Frames are only a few bytes long so copying the first channel's
+   * sample into the others a byte at a time beats calling memcpy().
+   */
+  for (int index=size; index<device->frameSize; index+=1) {
+    frame[index] = frame[index - size];
+  }
+}
+
 static int
-pcmWriteSample (NoteDevice *device, int16_t amplitude) {
-  PcmSample *sample = (PcmSample *)&device->blockAddress[device->blockUsed];
-  PcmSampleSize size = device->makeSample(sample, amplitude);
-  device->blockUsed += size;
-
-  for (int channel=1; channel<device->channelCount; channel+=1) {
-    for (int byte=0; byte<size; byte+=1) {
-      device->blockAddress[device->blockUsed++] = sample->bytes[byte];
-    }
+pcmWriteFrames (NoteDevice *device, const unsigned char *frames, size_t size) {
+  while (size) {
+    int count = MIN(size, (device->blockSize - device->blockUsed));
+
+    memcpy(&device->blockAddress[device->blockUsed], frames, count);
+    if (!pcmCommitBytes(device, count)) return 0;
+
+    frames += count;
+    size -= count;
   }
 
-  if (device->blockUsed == device->blockSize) {
-    if (!pcmFlushBytes(device)) {
-      return 0;
+  return 1;
+}
+
+static int
+pcmWriteSilence (NoteDevice *device, int32_t frameCount) {
+  while (frameCount > 0) {
+    int count = MIN(frameCount, pcmGetFreeFrames(device));
+    unsigned char *frames = &device->blockAddress[device->blockUsed];
+    size_t size = count * device->frameSize;
+    size_t filled = device->frameSize;
+
+    pcmMakeFrame(device, frames, 0);
+
+    while (filled < size) {
+      size_t length = MIN(filled, size-filled);
+
+      memcpy(&frames[filled], frames, length);
+      filled += length;
     }
+
+    if (!pcmCommitBytes(device, size)) return 0;
+    frameCount -= count;
   }
 
   return 1;
@@ -72,11 +129,8 @@ pcmWriteSample (NoteDevice *device, int16_t amplitude) {
 
 static int
 pcmFlushBlock (NoteDevice *device) {
-  while (device->blockUsed)
-    if (!pcmWriteSample(device, 0))
-      return 0;
-
-  return 1;
+  if (!device->blockUsed) return 1;
+  return pcmWriteSilence(device, pcmGetFreeFrames(device));
 }
 
 static NoteDevice *
@@ -98,6 +152,7 @@ pcmConstruct (int errorLevel) {
       PcmSample sample;
       PcmSampleSize sampleSize = device->makeSample(&sample, 0);
       sampleSize *= device->channelCount;
+      device->frameSize = sampleSize;
 
       if (sampleSize && device->blockSize &&
           !(device->blockSize % sampleSize)) {
@@ -130,12 +185,112 @@ pcmConstruct (int errorLevel) {
 static void
 pcmDestruct (NoteDevice *device) {
   pcmFlushBlock(device);
+
+  for (unsigned int index=0; index<ARRAY_COUNT(device->toneCache.entries); index+=1) {
+    PcmToneCacheEntry *entry = &device->toneCache.entries[index];
+    if (entry->frames) free(entry->frames);
+  }
+
   free(device->blockAddress);
   closePcmDevice(device->pcm);
   free(device);
   logMessage(LOG_DEBUG, "PCM disabled");
 }
 
+typedef struct {
+  int32_t currentValue;
+  uint32_t stepsPerSample;
+  int32_t maximumAmplitude;
+} PcmToneGenerator;
+
+static void
+pcmMakeToneFrames (
+  NoteDevice *device, PcmToneGenerator *generator,
+  unsigned char *frames, int32_t count
+) {
+  const uint8_t magnitudeWidth = 32 - 2;
+  const uint32_t zeroValue = UINT32_C(1) << magnitudeWidth;
+
+  int32_t currentValue = generator->currentValue;
+  const uint32_t stepsPerSample = generator->stepsPerSample;
+  const int32_t maximumAmplitude = generator->maximumAmplitude;
+
+  while (count > 0) {
+    /* Convert the current 32-bit unsigned linear value to a 31-bit
+     * triangular amplitude by inverting its low-order 31 bits if its
+     * high-order (sign) bit is set.
+     */
+    int32_t amplitude = currentValue ^ (currentValue >> 31);
+
+    /* Convert the 31-bit amplitude from unsigned to signed. */
+    amplitude -= zeroValue;
+
+    /* Convert the amplitude's magnitude from 30 bits to 16 bits. */
+    amplitude >>= magnitudeWidth - 16;
+
+    /* Adjust the 17-bit signed amplitude (sign bit + 16-bit value) by
+     * the currently set volume (15-bit value):
+     * (16-bit value) * (15-bit value) + (sign bit) = 32-bit signed value
+     */
+    amplitude *= maximumAmplitude;
+
+    /* Convert the signed amplitude from 32 bits to 16 bits. */
+    amplitude >>= 16;
+
+    pcmMakeFrame(device, frames, amplitude);
+    frames += device->frameSize;
+
+    currentValue += stepsPerSample;
+    count -= 1;
+  }
+
+  generator->currentValue = currentValue;
+}
+
+static PcmToneCacheEntry *
+pcmGetCachedTone (NoteDevice *device, NoteFrequency frequency, unsigned char volume, size_t size) {
+  PcmToneCacheEntry *entries = device->toneCache.entries;
+  const unsigned int count = ARRAY_COUNT(device->toneCache.entries);
+
+  for (unsigned int index=0; index<count; index+=1) {
+    PcmToneCacheEntry *entry = &entries[index];
+
+    if (entry->frames && (entry->frequency == frequency) && (entry->volume == volume)) {
+      if (entry->size >= size) return entry;
+
+      /* A shorter rendering of the same tone is a prefix of the longer one,
+       * so the entry is replaced with the longer one.
+       */
+      free(entry->frames);
+      entry->frames = NULL;
+      device->toneCache.next = index;
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static PcmToneCacheEntry *
+pcmNewCachedTone (NoteDevice *device, NoteFrequency frequency, unsigned char volume, size_t size) {
+  PcmToneCacheEntry *entry = &device->toneCache.entries[device->toneCache.next];
+  unsigned char *frames;
+
+  if (!(frames = malloc(size))) {
+    logMallocError();
+    return NULL;
+  }
+
+  if (entry->frames) free(entry->frames);
+  entry->frames = frames;
+  entry->size = size;
+  entry->frequency = frequency;
+  entry->volume = volume;
+
+  device->toneCache.next = (device->toneCache.next + 1) % ARRAY_COUNT(device->toneCache.entries);
+  return entry;
+}
+
 static int
 pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
   int32_t sampleCount = device->sampleRate * duration / 1000;
@@ -194,7 +349,11 @@ pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
      * that corresponds to the start of the first logical quarter wave
      * (the one that ascends from zero to the positive peak).
      */
-    int32_t currentValue = zeroValue;
+    PcmToneGenerator generator = {
+      .currentValue = zeroValue,
+      .stepsPerSample = stepsPerSample,
+      .maximumAmplitude = maximumAmplitude
+    };
 
     /* Round the number of samples up to a whole number of periods:
      * partialSteps = (sampleCount * stepsPerSample) % stepsPerWave
@@ -210,38 +369,36 @@ pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
      */
     sampleCount += (uint32_t)(sampleCount * -stepsPerSample) / stepsPerSample;
 
-    while (sampleCount > 0) {
-      /* Convert the current 32-bit unsigned linear value to a 31-bit
-       * triangular amplitude by inverting its low-order 31 bits if its
-       * high-order (sign) bit is set.
-       */
-      int32_t amplitude = currentValue ^ (currentValue >> 31);
-
-      /* Convert the 31-bit amplitude from unsigned to signed. */
-      amplitude -= zeroValue;
-
-      /* Convert the amplitude's magnitude from 30 bits to 16 bits. */
-      amplitude >>= magnitudeWidth - 16;
+    /* Every rendering of a tone starts at the same point of its waveform,
+     * so the frames for a short tone are also the start of those for a
+     * longer one at the same frequency and volume. Short tones are
+     * rendered once and then copied out of the cache.
+     */
+    {
+      size_t size = sampleCount * device->frameSize;
+      PcmToneCacheEntry *entry = pcmGetCachedTone(device, frequency, currentVolume, size);
 
-      /* Adjust the 17-bit signed amplitude (sign bit + 16-bit value) by
-       * the currently set volume (15-bit value):
-       * (16-bit value) * (15-bit value) + (sign bit) = 32-bit signed value
-       */
-      amplitude *= maximumAmplitude;
+      if (!entry && (size <= PCM_TONE_CACHE_LIMIT)) {
+        if ((entry = pcmNewCachedTone(device, frequency, currentVolume, size))) {
+          pcmMakeToneFrames(device, &generator, entry->frames, sampleCount);
+        }
+      }
 
-      /* Convert the signed amplitude from 32 bits to 16 bits. */
-      amplitude >>= 16;
+      if (entry) {
+        if (pcmWriteFrames(device, entry->frames, size)) sampleCount = 0;
+      } else {
+        while (sampleCount > 0) {
+          int32_t count = MIN(sampleCount, pcmGetFreeFrames(device));
 
-      if (!pcmWriteSample(device, amplitude)) break;
-      currentValue += stepsPerSample;
-      sampleCount -= 1;
+          pcmMakeToneFrames(device, &generator, &device->blockAddress[device->blockUsed], count);
+          if (!pcmCommitBytes(device, count * device->frameSize)) break;
+          sampleCount -= count;
+        }
+      }
     }
   } else {
     /* generate silence */
-    while (sampleCount > 0) {
-      if (!pcmWriteSample(device, 0)) break;
-      sampleCount -= 1;
-    }
+    if (pcmWriteSilence(device, sampleCount)) sampleCount = 0;
   }
 
   return (sampleCount > 0) ? 0 : 1;
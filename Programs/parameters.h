@@ -61,6 +61,8 @@ extern "C" {
 
 #define LEARN_MODE_TIMEOUT 10000
 
+#define COMMAND_QUEUE_SIZE 0X100
+
 #define INPUT_STICKY_MODIFIERS_TIMEOUT 5000
 
 #define MOUNT_TABLE_UPDATE_RETRY_INTERVAL 5000
@@ -80,6 +82,8 @@ extern "C" {
 #define BLUETOOTH_CHANNEL_BUSY_RETRY_TIMEOUT 2000
 #define BLUETOOTH_CHANNEL_BUSY_RETRY_INTERVAL 100
 #define BLUETOOTH_CHANNEL_CONNECT_TIMEOUT 15000
+#define BLUETOOTH_DEVICE_CACHE_LIFETIME (SECS_PER_DAY * 30)
+#define BLUETOOTH_DEVICE_CACHE_FILE "bluetooth-devices"
 
 #define LINUX_INPUT_DEVICE_OPEN_DELAY 1000
 #define LINUX_USB_INPUT_PIPE_DISABLE 0
@@ -91,6 +95,19 @@ extern "C" {
 
 #define WINDOWS_FILE_LOCK_RETRY_INTERVAL 1000
 
+#define PCM_TONE_CACHE_SIZE 8
+#define PCM_TONE_CACHE_LIMIT 0X8000
+
+#define LOG_FILE_BUFFER_SIZE 0X10000
+#define LOG_MESSAGE_HISTORY_SIZE 0X4000 /* must be a power of 2 */
+#define LOG_MESSAGE_HISTORY_LIMIT 0X100
+
+#define TABLE_CACHE_DIRECTORY "tables"
+
+#define CONTRACTION_REQUEST_LIMIT 0X10
+#define CONTRACTION_EXTERNAL_RESPONSE_TIMEOUT 2000
+#define CONTRACTION_EXTERNAL_INPUT_SIZE 0X1000
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
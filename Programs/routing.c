@@ -49,6 +49,8 @@
 #define ROUTING_NICENESS	10	/* niceness of cursor routing subprocess */
 #define ROUTING_INTERVAL	1	/* how often to check for response */
 #define ROUTING_TIMEOUT	2000	/* max wait for response to key press */
+#define ROUTING_MONITOR_INTERVAL	20	/* how often to check when the driver announces updates */
+#define ROUTING_BATCH_LIMIT	8	/* max keys to send before awaiting a response */
 
 typedef enum {
   CRR_DONE,
@@ -70,6 +72,7 @@ typedef struct {
 
   int cury, curx;
   int oldy, oldx;
+  unsigned predictable:1;
 
   long timeSum;
   int timeCount;
@@ -180,14 +183,14 @@ error:
 }
 
 static void
-moveCursor (RoutingData *routing, const CursorDirectionEntry *direction) {
+moveCursor (RoutingData *routing, const CursorDirectionEntry *direction, int count) {
 #ifdef SIGUSR1
   sigset_t oldMask;
   sigprocmask(SIG_BLOCK, &routing->signalMask, &oldMask);
 #endif /* SIGUSR1 */
 
-  logRouting("move: %s", direction->name);
-  insertScreenKey(direction->key);
+  logRouting("move: %s (%d)", direction->name, count);
+  while (count-- > 0) insertScreenKey(direction->key);
 
 #ifdef SIGUSR1
   sigprocmask(SIG_SETMASK, &oldMask, NULL);
@@ -195,7 +198,7 @@ moveCursor (RoutingData *routing, const CursorDirectionEntry *direction) {
 }
 
 static int
-awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *axis) {
+awaitCursorMotion (RoutingData *routing, int direction, int count, const CursorAxisEntry *axis) {
   int moved = 0;
   long int timeout = routing->timeSum / routing->timeCount;
   TimeValue start;
@@ -206,7 +209,7 @@ awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *a
   routing->oldy = routing->cury;
   routing->oldx = routing->curx;
 
-  axis->adjustCoordinate(&trgy, &trgx, direction);
+  axis->adjustCoordinate(&trgy, &trgx, (direction * count));
   getMonotonicTime(&start);
 
   while (1) {
@@ -216,7 +219,10 @@ awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *a
     int oldy;
     int oldx;
 
-    asyncWait(ROUTING_INTERVAL);
+    /* Only look at the screen again when the driver says that it has
+     * changed. Drivers which can't say so still need to be polled.
+     */
+    if (!awaitRoutingScreenUpdate(ROUTING_MONITOR_INTERVAL)) asyncWait(ROUTING_INTERVAL);
     getMonotonicTime(&now);
     time = millisecondsBetween(&start, &now) + 1;
 
@@ -291,12 +297,16 @@ awaitCursorMotion (RoutingData *routing, int direction, const CursorAxisEntry *a
 
 static RoutingResult
 adjustCursorPosition (RoutingData *routing, int where, int trgy, int trgx, const CursorAxisEntry *axis) {
+  int batching = 1;
+
   logRouting("to: [%d,%d]", trgx, trgy);
+  routing->predictable = 0;
 
   while (1) {
     int dify = trgy - routing->cury;
     int difx = (trgx < 0)? 0: (trgx - routing->curx);
     int dir;
+    int count = 1;
 
     /* determine which direction the cursor needs to move in */
     if (dify) {
@@ -307,9 +317,55 @@ adjustCursorPosition (RoutingData *routing, int where, int trgy, int trgx, const
       return CRR_DONE;
     }
 
+    /* Once each key has been seen to move the cursor by exactly one
+     * position, send several at a time - but never enough to overshoot.
+     */
+    if (batching && routing->predictable && (!dify || (trgx < 0))) {
+      int distance = dify? dify: difx;
+
+      if (distance < 0) distance = -distance;
+
+      /* Don't batch past the end of the line - most applications wrap
+       * onto the next one.
+       */
+      if (!dify && (dir > 0)) {
+        int last = routing->screenColumns - 1;
+
+        while ((last > routing->curx) && iswspace(routing->rowBuffer[last].text)) last -= 1;
+        if (distance > (last - routing->curx)) distance = last - routing->curx;
+      }
+
+      if ((count = distance / 2) < 1) count = 1;
+      if (count > ROUTING_BATCH_LIMIT) count = ROUTING_BATCH_LIMIT;
+    }
+
     /* tell the cursor to move in the needed direction */
-    moveCursor(routing, ((dir > 0)? axis->forward: axis->backward));
-    if (!awaitCursorMotion(routing, dir, axis)) return CRR_FAIL;
+    moveCursor(routing, ((dir > 0)? axis->forward: axis->backward), count);
+    if (!awaitCursorMotion(routing, dir, count, axis)) return CRR_FAIL;
+
+    {
+      int expy = routing->oldy;
+      int expx = routing->oldx;
+
+      axis->adjustCoordinate(&expy, &expx, (dir * count));
+      routing->predictable = (routing->cury == expy) && (routing->curx == expx);
+
+      if (!routing->predictable && (count > 1)) {
+        /* The batch didn't go where it was expected to (it may have
+         * wrapped onto another row), so undo all of it and only take
+         * single steps from now on.
+         */
+        logRouting("batch went astray: [%d,%d] -> [%d,%d]",
+                   routing->oldx, routing->oldy, routing->curx, routing->cury);
+
+        moveCursor(routing, ((dir > 0)? axis->backward: axis->forward), count);
+        if (!awaitCursorMotion(routing, -dir, count, axis)) return CRR_FAIL;
+
+        routing->predictable = 0;
+        batching = 0;
+        continue;
+      }
+    }
 
     if (routing->cury != routing->oldy) {
       if (routing->oldy != trgy) {
@@ -346,8 +402,8 @@ adjustCursorPosition (RoutingData *routing, int where, int trgy, int trgx, const
      * try going back to the previous position since it was obviously
      * the nearest ever reached.
      */
-    moveCursor(routing, ((dir > 0)? axis->backward: axis->forward));
-    return awaitCursorMotion(routing, -dir, axis)? CRR_NEAR: CRR_FAIL;
+    moveCursor(routing, ((dir > 0)? axis->backward: axis->forward), 1);
+    return awaitCursorMotion(routing, -dir, 1, axis)? CRR_NEAR: CRR_FAIL;
   }
 }
 
@@ -28,6 +28,7 @@
 #include <string.h>
 
 #include "log.h"
+#include "async_wait.h"
 #include "scr.h"
 #include "scr_real.h"
 #include "driver.h"
@@ -182,6 +183,9 @@ getScreenCommandContext (void) {
 }
 
 
+static unsigned char routingScreenActive = 0;
+static unsigned char routingScreenUpdated = 0;
+
 int
 constructRoutingScreen (void) {
   /* This function should be used in a forked process. Though we want to
@@ -189,11 +193,34 @@ constructRoutingScreen (void) {
    * in the main thread.  So we close and reopen the device.
    */
   mainScreen.destruct();
-  return mainScreen.construct();
+  routingScreenUpdated = 0;
+  return routingScreenActive = mainScreen.construct();
 }
 
 void
 destructRoutingScreen (void) {
+  routingScreenActive = 0;
   mainScreen.destruct();
   mainScreen.releaseParameters();
 }
+
+int
+announceRoutingScreenUpdate (void) {
+  if (!routingScreenActive) return 0;
+  routingScreenUpdated = 1;
+  return 1;
+}
+
+ASYNC_CONDITION_TESTER(testRoutingScreenUpdated) {
+  return routingScreenUpdated;
+}
+
+int
+awaitRoutingScreenUpdate (int timeout) {
+  /* A driver which can't announce updates needs to be polled. */
+  if (mainScreen.base.poll()) return 0;
+
+  asyncAwaitCondition(timeout, testRoutingScreenUpdated, NULL);
+  routingScreenUpdated = 0;
+  return 1;
+}
@@ -54,6 +54,8 @@ extern KeyTableCommandContext getScreenCommandContext (void);
  */
 extern int constructRoutingScreen (void);
 extern void destructRoutingScreen (void);
+extern int announceRoutingScreenUpdate (void);
+extern int awaitRoutingScreenUpdate (int timeout);
 
 extern const ScreenDriver *screen;
 extern const ScreenDriver noScreen;
@@ -0,0 +1,408 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2017 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://brltty.com/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+/* Stress test for version 2 of the shared screen image. A child process
+ * keeps updating a segment (via the writer functions in scr_shm.h) while
+ * this process reads it through the Screen screen driver. Each update
+ * changes some of the rows, filling each of them with one character, and
+ * the first row lists the character of every other row. Any read which
+ * finds a row that isn't uniform, or that disagrees with the first row, has
+ * seen a torn update. When the writer has finished, the driver must present
+ * its final frame exactly.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_SHMGET
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif /* HAVE_SHMGET */
+
+#include "program.h"
+#include "options.h"
+#include "log.h"
+#include "parse.h"
+#include "scr.h"
+#include "timing.h"
+#include "scr_shm.h"
+
+static char *opt_screenDriver;
+static char *opt_driversDirectory;
+static char *opt_updates;
+static char *opt_interval;
+static char *opt_rows;
+static char *opt_columns;
+
+BEGIN_OPTION_TABLE(programOptions)
+  { .letter = 'D',
+    .word = "drivers-directory",
+    .flags = OPT_Hidden,
+    .argument = "directory",
+    .setting.string = &opt_driversDirectory,
+    .internal.setting = DRIVERS_DIRECTORY,
+    .internal.adjust = fixInstallPath,
+    .description = "Path to directory for loading drivers."
+  },
+
+  { .letter = 'x',
+    .word = "screen-driver",
+    .argument = "driver",
+    .setting.string = &opt_screenDriver,
+    .internal.setting = "sc",
+    .description = "Screen driver which reads the shared screen image."
+  },
+
+  { .letter = 'u',
+    .word = "updates",
+    .argument = "count",
+    .setting.string = &opt_updates,
+    .internal.setting = "100000",
+    .description = "Number of updates to write."
+  },
+
+  { .letter = 'i',
+    .word = "interval",
+    .argument = "microseconds",
+    .setting.string = &opt_interval,
+    .internal.setting = "10",
+    .description = "Time to wait between updates."
+  },
+
+  { .letter = 'r',
+    .word = "rows",
+    .argument = "count",
+    .setting.string = &opt_rows,
+    .internal.setting = "25",
+    .description = "Height of the screen."
+  },
+
+  { .letter = 'c',
+    .word = "columns",
+    .argument = "count",
+    .setting.string = &opt_columns,
+    .internal.setting = "80",
+    .description = "Width of the screen."
+  },
+END_OPTION_TABLE
+
+#define ROW_CHARACTER(update) (0X4E00 + ((update) % 0X1000))
+
+static int
+isRowChanged (unsigned int row, unsigned int update, unsigned int updates) {
+  if (!row) return 0;
+  if (update == updates) return 1;
+  return ((row + update) % 3) == 0;
+}
+
+static void
+writeScreenRow (ScreenSegmentHeader *header, unsigned int row, const uint32_t *text) {
+  unsigned char attributes[header->columns];
+
+  memset(attributes, 0X07, sizeof(attributes));
+  setScreenSegmentRow(header, row, text, attributes);
+}
+
+static void
+writeIndexRow (ScreenSegmentHeader *header, const uint32_t *characters) {
+  unsigned int rows = header->rows;
+  unsigned int columns = header->columns;
+  uint32_t text[columns];
+  unsigned int index;
+
+  for (index=0; index<columns; index+=1) {
+    text[index] = ((index > 0) && (index < rows))? characters[index]: ' ';
+  }
+
+  writeScreenRow(header, 0, text);
+}
+
+static void
+writeScreenUpdate (
+  ScreenSegmentHeader *header, uint32_t *characters,
+  unsigned int update, unsigned int updates
+) {
+  unsigned int rows = header->rows;
+  unsigned int columns = header->columns;
+  unsigned int row;
+
+  beginScreenSegmentUpdate(header);
+
+  for (row=1; row<rows; row+=1) {
+    if (!update || isRowChanged(row, update, updates)) {
+      uint32_t text[columns];
+      unsigned int column;
+
+      characters[row] = ROW_CHARACTER(update);
+      for (column=0; column<columns; column+=1) text[column] = characters[row];
+      writeScreenRow(header, row, text);
+    }
+  }
+
+  writeIndexRow(header, characters);
+  setScreenSegmentCursor(header, (update % rows), (update % columns));
+  setScreenSegmentWindow(header, 0, 0);
+
+  endScreenSegmentUpdate(header);
+}
+
+typedef enum {
+  READ_CONSISTENT,
+  READ_BUSY,
+  READ_TORN
+} ReadResult;
+
+static ReadResult
+readScreenUpdate (unsigned int rows, unsigned int columns, const uint32_t *expected) {
+  ScreenDescription description;
+
+  describeScreen(&description);
+  if (description.unreadable) return READ_BUSY;
+
+  if ((description.rows != rows) || (description.cols != columns)) {
+    logMessage(LOG_ERR, "unexpected screen size: %dx%d", description.cols, description.rows);
+    return READ_TORN;
+  }
+
+  {
+    ScreenCharacter buffer[rows * columns];
+    unsigned int row;
+
+    if (!readScreen(0, 0, columns, rows, buffer)) {
+      logMessage(LOG_ERR, "can't read screen");
+      return READ_TORN;
+    }
+
+    for (row=1; row<rows; row+=1) {
+      const ScreenCharacter *line = &buffer[row * columns];
+      wchar_t character = line[0].text;
+      unsigned int column;
+
+      for (column=1; column<columns; column+=1) {
+        if (line[column].text != character) {
+          logMessage(LOG_ERR, "torn row: %u", row);
+          return READ_TORN;
+        }
+      }
+
+      if (buffer[row].text != character) {
+        logMessage(LOG_ERR, "rows from different updates: %u", row);
+        return READ_TORN;
+      }
+
+      if (expected && (character != expected[row])) {
+        logMessage(LOG_ERR, "stale row: %u", row);
+        return READ_TORN;
+      }
+    }
+  }
+
+  return READ_CONSISTENT;
+}
+
+int
+main (int argc, char *argv[]) {
+  ProgramExitStatus exitStatus = PROG_EXIT_FATAL;
+  int updates;
+  int interval;
+  int rows;
+  int columns;
+
+  {
+    static const OptionsDescriptor descriptor = {
+      OPTION_TABLE(programOptions),
+      .applicationName = "scrshmtest"
+    };
+    PROCESS_OPTIONS(descriptor, argc, argv);
+  }
+
+  {
+    static const int minimum = 1;
+
+    if (!validateInteger(&updates, opt_updates, &minimum, NULL)) {
+      logMessage(LOG_ERR, "invalid update count: %s", opt_updates);
+      return PROG_EXIT_SYNTAX;
+    }
+  }
+
+  {
+    static const int minimum = 0;
+
+    if (!validateInteger(&interval, opt_interval, &minimum, NULL)) {
+      logMessage(LOG_ERR, "invalid interval: %s", opt_interval);
+      return PROG_EXIT_SYNTAX;
+    }
+  }
+
+  {
+    static const int minimum = 2;
+    static const int maximum = 0XFFFF;
+
+    if (!validateInteger(&rows, opt_rows, &minimum, &maximum)) {
+      logMessage(LOG_ERR, "invalid row count: %s", opt_rows);
+      return PROG_EXIT_SYNTAX;
+    }
+
+    if (!validateInteger(&columns, opt_columns, &rows, &maximum)) {
+      logMessage(LOG_ERR, "invalid column count: %s", opt_columns);
+      return PROG_EXIT_SYNTAX;
+    }
+  }
+
+#ifdef HAVE_SHMGET
+  {
+    const char *path = getenv("HOME");
+    key_t key;
+    int identifier;
+
+    /* This is the key which the Screen screen driver tries first. */
+    if (!path || !*path) path = "/";
+
+    if ((key = ftok(path, 'b')) == -1) {
+      logSystemError("ftok");
+    } else if ((identifier = shmget(key, getScreenSegmentSize(rows, columns),
+                                    (IPC_CREAT | IPC_EXCL | S_IRWXU))) == -1) {
+      logMessage(LOG_ERR, "can't create shared screen image (try setting HOME to an empty directory): %s",
+                 strerror(errno));
+    } else {
+      ScreenSegmentHeader *header;
+
+      if ((header = shmat(identifier, NULL, 0)) == (void *)-1) {
+        logSystemError("shmat");
+      } else {
+        uint32_t characters[rows];
+        pid_t writer;
+
+        initializeScreenSegment(header, rows, columns);
+        beginScreenSegmentUpdate(header);
+        setScreenSegmentSize(header, rows, columns);
+        endScreenSegmentUpdate(header);
+        writeScreenUpdate(header, characters, 0, updates);
+
+        if ((writer = fork()) == -1) {
+          logSystemError("fork");
+        } else if (!writer) {
+          const TimeValue delay = {
+            .seconds = interval / USECS_PER_SEC,
+            .nanoseconds = (interval % USECS_PER_SEC) * NSECS_PER_USEC
+          };
+
+          int update;
+
+          /* A writer which never pauses can keep every read from
+           * completing, which isn't what a terminal does.
+           */
+          for (update=1; update<=updates; update+=1) {
+            writeScreenUpdate(header, characters, update, updates);
+            if (interval) accurateDelay(&delay);
+          }
+
+          _exit(0);
+        } else {
+          void *driverObject;
+
+          if ((screen = loadScreenDriver(opt_screenDriver, &driverObject, opt_driversDirectory))) {
+            static char *parameters[] = {NULL};
+
+            if (constructScreenDriver(parameters)) {
+              unsigned long int reads = 0;
+              unsigned long int busy = 0;
+              unsigned long int torn = 0;
+              int status;
+
+              while (waitpid(writer, &status, WNOHANG) == 0) {
+                reads += 1;
+
+                switch (readScreenUpdate(rows, columns, NULL)) {
+                  case READ_BUSY:
+                    busy += 1;
+                    break;
+
+                  case READ_TORN:
+                    torn += 1;
+                    break;
+
+                  default:
+                    break;
+                }
+              }
+
+              writer = 0;
+
+              {
+                int update;
+
+                for (update=1; update<=updates; update+=1) {
+                  int row;
+
+                  for (row=1; row<rows; row+=1) {
+                    if (isRowChanged(row, update, updates)) {
+                      characters[row] = ROW_CHARACTER(update);
+                    }
+                  }
+                }
+              }
+
+              printf("Reads: %lu\n", reads);
+              printf("Busy: %lu\n", busy);
+              printf("Torn: %lu\n", torn);
+
+              if (readScreenUpdate(rows, columns, characters) != READ_CONSISTENT) {
+                logMessage(LOG_ERR, "final screen doesn't match the last update");
+              } else if (!torn) {
+                exitStatus = PROG_EXIT_SUCCESS;
+              }
+
+              destructScreenDriver();
+            } else {
+              logMessage(LOG_ERR, "can't open screen.");
+            }
+          } else {
+            logMessage(LOG_ERR, "can't load screen driver.");
+          }
+
+          if (writer) {
+            kill(writer, SIGKILL);
+            waitpid(writer, NULL, 0);
+          }
+        }
+
+        shmdt(header);
+      }
+
+      shmctl(identifier, IPC_RMID, NULL);
+    }
+  }
+#else /* HAVE_SHMGET */
+  logMessage(LOG_ERR, "shared memory not supported");
+#endif /* HAVE_SHMGET */
+
+  return exitStatus;
+}
+
+#include "update.h"
+
+void
+scheduleUpdateIn (const char *reason, int delay) {
+}
@@ -608,9 +608,73 @@ sendSpeechRequest (volatile SpeechDriverThread *sdt) {
   }
 }
 
+static int
+isSameSpeechText (const SpeechRequest *req1, const SpeechRequest *req2) {
+  if (req1->arguments.sayText.options != req2->arguments.sayText.options) return 0;
+  if (req1->arguments.sayText.length != req2->arguments.sayText.length) return 0;
+  if (req1->arguments.sayText.count != req2->arguments.sayText.count) return 0;
+
+  if (memcmp(req1->arguments.sayText.text, req2->arguments.sayText.text,
+             req1->arguments.sayText.length) != 0) return 0;
+
+  if (!req1->arguments.sayText.attributes != !req2->arguments.sayText.attributes) return 0;
+  if (!req1->arguments.sayText.attributes) return 1;
+
+  return memcmp(req1->arguments.sayText.attributes, req2->arguments.sayText.attributes,
+                req1->arguments.sayText.count) == 0;
+}
+
+static int
+coalesceSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequest *req) {
+  Element *element = getStackHead(sdt->requestQueue);
+
+  if (element) {
+    SpeechRequest *last = getElementItem(element);
+
+    if (last && req && (last->type == req->type)) {
+      switch (req->type) {
+        case REQ_SAY_TEXT:
+          if (isSameSpeechText(last, req)) break;
+          return 0;
+
+        case REQ_SET_VOLUME:
+          last->arguments.setVolume = req->arguments.setVolume;
+          break;
+
+        case REQ_SET_RATE:
+          last->arguments.setRate = req->arguments.setRate;
+          break;
+
+        case REQ_SET_PITCH:
+          last->arguments.setPitch = req->arguments.setPitch;
+          break;
+
+        case REQ_SET_PUNCTUATION:
+          last->arguments.setPunctuation = req->arguments.setPunctuation;
+          break;
+
+        default:
+          return 0;
+      }
+
+      logSpeechRequest(req, "coalescing");
+      free(req);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
 static int
 enqueueSpeechRequest (volatile SpeechDriverThread *sdt, SpeechRequest *req) {
   if (testThreadValidity(sdt)) {
+    /* Requests which haven't been sent to the driver thread yet are still on
+     * the queue. An identical text, or a setting which is about to be
+     * changed again anyway, needn't be sent twice.
+     */
+    if (coalesceSpeechRequest(sdt, req)) return 1;
+
     logSpeechRequest(req, "enqueuing");
 
     if (enqueueItem(sdt->requestQueue, req)) {
@@ -0,0 +1,545 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2017 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://brltty.com/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+#include "log.h"
+#include "tbl_cache.h"
+#include "datafile.h"
+#include "dataarea.h"
+#include "file.h"
+#include "parameters.h"
+
+#define TABLE_CACHE_MAGIC "BRLTBLC"
+#define TABLE_CACHE_VERSION 2
+#define TABLE_CACHE_BYTE_ORDER 0X01020304
+#define TABLE_CACHE_DATA_ALIGNMENT 0X10
+#define TABLE_CACHE_PATH_ALIGNMENT 8
+
+typedef struct {
+  char magic[8];
+  char type[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint8_t characterSize;
+  uint8_t offsetSize;
+  uint16_t dependencyCount;
+  uint32_t dataOffset;
+  uint32_t dataSize;
+  uint64_t dataChecksum;
+} TableCacheHeader;
+
+typedef struct {
+  int64_t modificationTime;
+  uint64_t size;
+  uint64_t checksum;
+  uint16_t pathLength;
+  uint16_t reserved[3];
+} TableCacheDependency;
+
+static size_t
+alignTableCacheSize (size_t size, size_t alignment) {
+  return (size + (alignment - 1)) / alignment * alignment;
+}
+
+static uint64_t
+hashTableCacheBytes (uint64_t hash, const void *bytes, size_t count) {
+  const unsigned char *byte = bytes;
+  const unsigned char *end = byte + count;
+
+  while (byte < end) {
+    hash ^= *byte++;
+    hash *= UINT64_C(0X100000001B3);
+  }
+
+  return hash;
+}
+
+#define TABLE_CACHE_HASH_INITIAL UINT64_C(0XCBF29CE484222325)
+
+static int
+getTableFileChecksum (const char *path, uint64_t *checksum) {
+  FILE *stream;
+
+  if ((stream = openFile(path, "rb", 0))) {
+    uint64_t hash = TABLE_CACHE_HASH_INITIAL;
+    unsigned char buffer[0X1000];
+    size_t count;
+
+    while ((count = fread(buffer, 1, sizeof(buffer), stream))) {
+      hash = hashTableCacheBytes(hash, buffer, count);
+    }
+
+    {
+      int ok = !ferror(stream);
+
+      if (ok) {
+        *checksum = hash;
+      } else {
+        logSystemError("fread");
+      }
+
+      fclose(stream);
+      return ok;
+    }
+  }
+
+  return 0;
+}
+
+static char *
+makeAbsoluteTablePath (const char *path) {
+  if (isAbsolutePath(path)) {
+    char *copy = strdup(path);
+
+    if (!copy) logMallocError();
+    return copy;
+  }
+
+  {
+    char *directory = getWorkingDirectory();
+
+    if (directory) {
+      char *absolute = makePath(directory, path);
+
+      free(directory);
+      return absolute;
+    }
+  }
+
+  return NULL;
+}
+
+static char *
+makeTableCachePath (const char *type, const char *source) {
+  char *path = NULL;
+  char *directory = makeWritablePath(TABLE_CACHE_DIRECTORY);
+
+  if (directory) {
+    if (ensureDirectory(directory)) {
+      uint64_t hash = hashTableCacheBytes(TABLE_CACHE_HASH_INITIAL, source, strlen(source));
+      char name[0X40];
+
+      snprintf(name, sizeof(name), "%s-%016" PRIX64 ".cache", type, hash);
+      path = makePath(directory, name);
+    }
+
+    free(directory);
+  }
+
+  return path;
+}
+
+struct TableCacheMappingStruct {
+  void *address;
+  size_t size;
+  unsigned isMapped:1;
+};
+
+static int
+isCurrentTableDependency (const char *path, const TableCacheDependency *dependency) {
+  struct stat status;
+
+  if (stat(path, &status) == -1) return 0;
+  if (status.st_size != dependency->size) return 0;
+  if (status.st_mtime == dependency->modificationTime) return 1;
+
+  {
+    uint64_t checksum;
+
+    if (!getTableFileChecksum(path, &checksum)) return 0;
+    return checksum == dependency->checksum;
+  }
+}
+
+static const void *
+verifyTableCache (const unsigned char *address, size_t size, const char *type, const char *source, size_t *dataSize) {
+  const TableCacheHeader *header = (const void *)address;
+  size_t offset = sizeof(*header);
+
+  if (size < offset) return NULL;
+  if (memcmp(header->magic, TABLE_CACHE_MAGIC, sizeof(header->magic)) != 0) return NULL;
+  if (strncmp(header->type, type, sizeof(header->type)) != 0) return NULL;
+  if (header->version != TABLE_CACHE_VERSION) return NULL;
+  if (header->byteOrder != TABLE_CACHE_BYTE_ORDER) return NULL;
+  if (header->characterSize != sizeof(wchar_t)) return NULL;
+  if (header->offsetSize != sizeof(DataOffset)) return NULL;
+  if (!header->dependencyCount) return NULL;
+
+  if (header->dataOffset % TABLE_CACHE_DATA_ALIGNMENT) return NULL;
+  if (header->dataOffset > size) return NULL;
+  if (header->dataSize > (size - header->dataOffset)) return NULL;
+
+  {
+    unsigned int index;
+
+    for (index=0; index<header->dependencyCount; index+=1) {
+      const TableCacheDependency *dependency = (const void *)&address[offset];
+
+      if ((offset += sizeof(*dependency)) > header->dataOffset) return NULL;
+      if ((offset + dependency->pathLength) > header->dataOffset) return NULL;
+
+      {
+        char path[dependency->pathLength + 1];
+
+        memcpy(path, &address[offset], dependency->pathLength);
+        path[dependency->pathLength] = 0;
+
+        if (!index && (strcmp(path, source) != 0)) return NULL;
+        if (!isCurrentTableDependency(path, dependency)) return NULL;
+      }
+
+      offset += alignTableCacheSize(dependency->pathLength, TABLE_CACHE_PATH_ALIGNMENT);
+    }
+  }
+
+  /* A truncated or damaged cache mustn't be used - the table will just
+   * be compiled again.
+   */
+  if (hashTableCacheBytes(TABLE_CACHE_HASH_INITIAL, &address[header->dataOffset], header->dataSize) != header->dataChecksum) {
+    logMessage(LOG_WARNING, "table cache data checksum mismatch: %s", source);
+    return NULL;
+  }
+
+  *dataSize = header->dataSize;
+  return &address[header->dataOffset];
+}
+
+static int
+loadTableCache (TableCacheMapping *mapping, const char *path) {
+  int ok = 0;
+  int descriptor = open(path, O_RDONLY);
+
+  if (descriptor != -1) {
+    struct stat status;
+
+    if (fstat(descriptor, &status) != -1) {
+      mapping->size = status.st_size;
+
+#ifdef HAVE_SYS_MMAN_H
+      {
+        void *address = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+        if (address != MAP_FAILED) {
+          mapping->address = address;
+          mapping->isMapped = 1;
+          ok = 1;
+        } else {
+          logSystemError("mmap");
+        }
+      }
+#else /* HAVE_SYS_MMAN_H */
+      if ((mapping->address = malloc(mapping->size))) {
+        ssize_t count = read(descriptor, mapping->address, mapping->size);
+
+        if (count == mapping->size) {
+          mapping->isMapped = 0;
+          ok = 1;
+        } else {
+          if (count == -1) logSystemError("read");
+          free(mapping->address);
+        }
+      } else {
+        logMallocError();
+      }
+#endif /* HAVE_SYS_MMAN_H */
+    } else {
+      logSystemError("fstat");
+    }
+
+    close(descriptor);
+  } else if (errno != ENOENT) {
+    logMessage(LOG_WARNING, "table cache open error: %s: %s", path, strerror(errno));
+  }
+
+  return ok;
+}
+
+void
+unmapCachedTable (TableCacheMapping *mapping) {
+#ifdef HAVE_SYS_MMAN_H
+  if (mapping->isMapped) {
+    munmap(mapping->address, mapping->size);
+  } else
+#endif /* HAVE_SYS_MMAN_H */
+
+  {
+    free(mapping->address);
+  }
+
+  free(mapping);
+}
+
+const void *
+mapCachedTable (const char *type, const char *path, size_t *size, TableCacheMapping **mapping) {
+  const void *data = NULL;
+  char *source = makeAbsoluteTablePath(path);
+
+  if (source) {
+    char *cache = makeTableCachePath(type, source);
+
+    if (cache) {
+      TableCacheMapping *map;
+
+      if ((map = malloc(sizeof(*map)))) {
+        memset(map, 0, sizeof(*map));
+
+        if (loadTableCache(map, cache)) {
+          if ((data = verifyTableCache(map->address, map->size, type, source, size))) {
+            logMessage(LOG_DEBUG, "table cache loaded: %s: %s", source, cache);
+            *mapping = map;
+            map = NULL;
+          } else {
+            logMessage(LOG_DEBUG, "table cache stale: %s: %s", source, cache);
+            unmapCachedTable(map);
+            map = NULL;
+          }
+        }
+
+        if (map) free(map);
+      } else {
+        logMallocError();
+      }
+
+      free(cache);
+    }
+
+    free(source);
+  }
+
+  return data;
+}
+
+struct TableCacheRecorderStruct {
+  char *type;
+  char *source;
+  char *cache;
+  unsigned failed:1;
+
+  struct {
+    char **array;
+    unsigned int size;
+    unsigned int count;
+  } dependencies;
+};
+
+static void
+recordTableDependency (const char *path, void *data) {
+  TableCacheRecorder *recorder = data;
+  char *absolute;
+
+  if (recorder->dependencies.count == recorder->dependencies.size) {
+    unsigned int newSize = recorder->dependencies.size? recorder->dependencies.size<<1: 4;
+    char **newArray = realloc(recorder->dependencies.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      recorder->failed = 1;
+      return;
+    }
+
+    recorder->dependencies.array = newArray;
+    recorder->dependencies.size = newSize;
+  }
+
+  if ((absolute = makeAbsoluteTablePath(path))) {
+    recorder->dependencies.array[recorder->dependencies.count++] = absolute;
+  } else {
+    recorder->failed = 1;
+  }
+}
+
+TableCacheRecorder *
+startTableCacheRecorder (const char *type, const char *path) {
+  TableCacheRecorder *recorder;
+
+  if ((recorder = malloc(sizeof(*recorder)))) {
+    memset(recorder, 0, sizeof(*recorder));
+    recorder->failed = 0;
+
+    recorder->dependencies.array = NULL;
+    recorder->dependencies.size = 0;
+    recorder->dependencies.count = 0;
+
+    if ((recorder->type = strdup(type))) {
+      if ((recorder->source = makeAbsoluteTablePath(path))) {
+        if ((recorder->cache = makeTableCachePath(type, recorder->source))) {
+          setDataFileOpenedHandler(recordTableDependency, recorder);
+          return recorder;
+        }
+
+        free(recorder->source);
+      }
+
+      free(recorder->type);
+    } else {
+      logMallocError();
+    }
+
+    free(recorder);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static int
+writeTableCacheBytes (FILE *stream, const void *bytes, size_t count) {
+  if (fwrite(bytes, 1, count, stream) == count) return 1;
+  logSystemError("fwrite");
+  return 0;
+}
+
+static int
+writeTableCachePadding (FILE *stream, size_t count) {
+  static const unsigned char padding[TABLE_CACHE_DATA_ALIGNMENT] = {0};
+  return writeTableCacheBytes(stream, padding, count);
+}
+
+static int
+writeTableCache (FILE *stream, TableCacheRecorder *recorder, const void *data, size_t size) {
+  unsigned int count = recorder->dependencies.count;
+  TableCacheDependency dependencies[count];
+  size_t offset = sizeof(TableCacheHeader);
+
+  {
+    unsigned int index;
+
+    for (index=0; index<count; index+=1) {
+      const char *path = recorder->dependencies.array[index];
+      TableCacheDependency *dependency = &dependencies[index];
+      struct stat status;
+
+      if (stat(path, &status) == -1) {
+        logMessage(LOG_WARNING, "table dependency stat error: %s: %s", path, strerror(errno));
+        return 0;
+      }
+
+      memset(dependency, 0, sizeof(*dependency));
+      dependency->modificationTime = status.st_mtime;
+      dependency->size = status.st_size;
+      dependency->pathLength = strlen(path);
+      if (!getTableFileChecksum(path, &dependency->checksum)) return 0;
+
+      offset += sizeof(*dependency);
+      offset += alignTableCacheSize(dependency->pathLength, TABLE_CACHE_PATH_ALIGNMENT);
+    }
+  }
+
+  {
+    TableCacheHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TABLE_CACHE_MAGIC, sizeof(header.magic));
+    strncpy(header.type, recorder->type, sizeof(header.type) - 1);
+    header.version = TABLE_CACHE_VERSION;
+    header.byteOrder = TABLE_CACHE_BYTE_ORDER;
+    header.characterSize = sizeof(wchar_t);
+    header.offsetSize = sizeof(DataOffset);
+    header.dependencyCount = count;
+    header.dataOffset = alignTableCacheSize(offset, TABLE_CACHE_DATA_ALIGNMENT);
+    header.dataSize = size;
+    header.dataChecksum = hashTableCacheBytes(TABLE_CACHE_HASH_INITIAL, data, size);
+
+    if (!writeTableCacheBytes(stream, &header, sizeof(header))) return 0;
+
+    {
+      unsigned int index;
+
+      for (index=0; index<count; index+=1) {
+        const TableCacheDependency *dependency = &dependencies[index];
+        size_t length = dependency->pathLength;
+
+        if (!writeTableCacheBytes(stream, dependency, sizeof(*dependency))) return 0;
+        if (!writeTableCacheBytes(stream, recorder->dependencies.array[index], length)) return 0;
+        if (!writeTableCachePadding(stream, alignTableCacheSize(length, TABLE_CACHE_PATH_ALIGNMENT) - length)) return 0;
+      }
+    }
+
+    if (!writeTableCachePadding(stream, header.dataOffset - offset)) return 0;
+  }
+
+  return writeTableCacheBytes(stream, data, size);
+}
+
+static void
+saveTableCache (TableCacheRecorder *recorder, const void *data, size_t size) {
+  const char *source = recorder->source;
+
+  if (recorder->failed) return;
+  if (!recorder->dependencies.count) return;
+  if (strcmp(recorder->dependencies.array[0], source) != 0) return;
+  if (recorder->dependencies.count > UINT16_MAX) return;
+  if (size > UINT32_MAX) return;
+
+  {
+    const char *cache = recorder->cache;
+    char path[strlen(cache) + 0X20];
+    FILE *stream;
+
+    /* Another process may be saving the same cache at the same time. */
+    snprintf(path, sizeof(path), "%s.%ld.new", cache, (long int)getpid());
+
+    if ((stream = openFile(path, "wb", 0))) {
+      int ok = writeTableCache(stream, recorder, data, size);
+
+      if (fclose(stream) == EOF) {
+        logSystemError("fclose");
+        ok = 0;
+      }
+
+      if (ok) {
+        if (rename(path, cache) != -1) {
+          logMessage(LOG_DEBUG, "table cache saved: %s: %s", source, cache);
+          return;
+        }
+
+        logSystemError("rename");
+      }
+
+      unlink(path);
+    }
+  }
+}
+
+void
+stopTableCacheRecorder (TableCacheRecorder *recorder, const void *data, size_t size) {
+  setDataFileOpenedHandler(NULL, NULL);
+  if (data) saveTableCache(recorder, data, size);
+
+  while (recorder->dependencies.count) {
+    free(recorder->dependencies.array[--recorder->dependencies.count]);
+  }
+
+  if (recorder->dependencies.array) free(recorder->dependencies.array);
+  free(recorder->cache);
+  free(recorder->source);
+  free(recorder->type);
+  free(recorder);
+}
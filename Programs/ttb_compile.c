@@ -362,7 +362,12 @@ makeTextTable (TextTableData *ttd) {
 void
 destroyTextTable (TextTable *table) {
   if (table->size) {
-    free(table->header.fields);
+    if (table->mapping) {
+      unmapCachedTable(table->mapping);
+    } else {
+      free(table->header.fields);
+    }
+
     free(table);
   }
 }
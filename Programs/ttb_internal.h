@@ -22,6 +22,7 @@
 #include "bitmask.h"
 #include "unicode.h"
 #include "dataarea.h"
+#include "tbl_cache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,10 +68,16 @@ struct TextTableStruct {
   } header;
 
   size_t size;
+  TableCacheMapping *mapping;
 
   struct {
     unsigned char tryBaseCharacter;
   } options;
+
+  struct {
+    unsigned char dots[CHARSET_BYTE_COUNT];
+    unsigned char isValid;
+  } latin1;
 };
 
 extern const TextTableAliasEntry *locateTextTableAlias (
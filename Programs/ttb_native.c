@@ -18,6 +18,9 @@
 
 #include "prologue.h"
 
+#include <string.h>
+
+#include "log.h"
 #include "file.h"
 #include "ttb.h"
 #include "ttb_internal.h"
@@ -212,21 +215,61 @@ processTextTableStream (FILE *stream, const char *name) {
   return processTextTableLines(stream, name, processNativeTextTableOperands);
 }
 
+static TextTable *
+loadCachedTextTable (const char *name) {
+  TableCacheMapping *mapping;
+  size_t size;
+  const void *bytes = mapCachedTable("ttb", name, &size, &mapping);
+
+  if (bytes) {
+    TextTable *table = malloc(sizeof(*table));
+
+    if (table) {
+      memset(table, 0, sizeof(*table));
+
+      table->header.bytes = bytes;
+      table->size = size;
+      table->mapping = mapping;
+
+      table->options.tryBaseCharacter = 1;
+      return table;
+    } else {
+      logMallocError();
+    }
+
+    unmapCachedTable(mapping);
+  }
+
+  return NULL;
+}
+
 TextTable *
 compileTextTable (const char *name) {
-  TextTable *table = NULL;
-  FILE *stream;
+  TextTable *table = loadCachedTextTable(name);
 
-  if ((stream = openDataFile(name, "r", 0))) {
-    TextTableData *ttd;
+  if (!table) {
+    TableCacheRecorder *recorder = startTableCacheRecorder("ttb", name);
+    FILE *stream;
 
-    if ((ttd = processTextTableStream(stream, name))) {
-      table = makeTextTable(ttd);
+    if ((stream = openDataFile(name, "r", 0))) {
+      TextTableData *ttd;
 
-      destroyTextTableData(ttd);
+      if ((ttd = processTextTableStream(stream, name))) {
+        table = makeTextTable(ttd);
+
+        destroyTextTableData(ttd);
+      }
+
+      fclose(stream);
     }
 
-    fclose(stream);
+    if (recorder) {
+      if (table) {
+        stopTableCacheRecorder(recorder, table->header.bytes, table->size);
+      } else {
+        stopTableCacheRecorder(recorder, NULL, 0);
+      }
+    }
   }
 
   return table;
@@ -89,6 +89,7 @@ getUnicodeCellEntry (TextTable *table, wchar_t character) {
 void
 setTryBaseCharacter (TextTable *table, unsigned char yes) {
   table->options.tryBaseCharacter = yes;
+  table->latin1.isValid = 0;
 }
 
 static int
@@ -202,6 +203,36 @@ convertCharacterToDots (TextTable *table, wchar_t character) {
   return BRL_DOT_1 | BRL_DOT_2 | BRL_DOT_3 | BRL_DOT_4 | BRL_DOT_5 | BRL_DOT_6 | BRL_DOT_7 | BRL_DOT_8;
 }
 
+static const unsigned char *
+getLatin1Dots (TextTable *table) {
+  if (!table->latin1.isValid) {
+    for (unsigned int character=0; character<CHARSET_BYTE_COUNT; character+=1) {
+      table->latin1.dots[character] = convertCharacterToDots(table, character);
+    }
+
+    table->latin1.isValid = 1;
+  }
+
+  return table->latin1.dots;
+}
+
+void
+convertCharactersToDots (TextTable *table, const wchar_t *characters, unsigned char *cells, size_t count) {
+  const unsigned char *latin1 = getLatin1Dots(table);
+  const wchar_t *end = characters + count;
+
+  /* Most screen content is within the first Unicode row (Latin-1), which is
+   * translated via a per-table lookup. Anything else goes the long way.
+   */
+  while (characters < end) {
+    wchar_t character = *characters++;
+
+    *cells++ = (character & ~UNICODE_CELL_MASK)?
+               convertCharacterToDots(table, character):
+               latin1[character];
+  }
+}
+
 wchar_t
 convertDotsToCharacter (TextTable *table, unsigned char dots) {
   const TextTableHeader *header = table->header.fields;
@@ -27,6 +27,7 @@
 #include "strfmt.h"
 #include "update.h"
 #include "async_alarm.h"
+#include "async_task.h"
 #include "timing.h"
 #include "unicode.h"
 #include "charset.h"
@@ -308,6 +309,43 @@ showInfo (void) {
 #ifdef ENABLE_SPEECH_SUPPORT
 static int wasAutospeaking;
 
+static int
+findTextShift (
+  const ScreenCharacter *pattern,
+  const ScreenCharacter *characters,
+  int count
+) {
+  /* Find the smallest shift for which the characters, from that offset to
+   * the end, match the start of the pattern. This is the longest suffix of
+   * the characters which is also a prefix of the pattern, and, as with
+   * Knuth-Morris-Pratt, it can be found in linear time.
+   */
+  int prefixes[count];
+  int length = 0;
+
+  if (count) prefixes[0] = 0;
+
+  for (int index=1; index<count; index+=1) {
+    while (length && (pattern[index].text != pattern[length].text)) {
+      length = prefixes[length - 1];
+    }
+
+    if (pattern[index].text == pattern[length].text) length += 1;
+    prefixes[index] = length;
+  }
+
+  length = 0;
+  for (int index=0; index<count; index+=1) {
+    while (length && ((length == count) || (characters[index].text != pattern[length].text))) {
+      length = prefixes[length - 1];
+    }
+
+    if (characters[index].text == pattern[length].text) length += 1;
+  }
+
+  return count - length;
+}
+
 void
 autospeak (AutospeakMode mode) {
   static int oldScreen = -1;
@@ -359,7 +397,6 @@ autospeak (AutospeakMode mode) {
               isSameRow(newCharacters, oldCharacters, newX, isSameText)) {
             int oldLength = oldWidth;
             int newLength = newWidth;
-            int x = newX;
 
             while (oldLength > oldX) {
               if (!iswspace(oldCharacters[oldLength-1].text)) break;
@@ -373,34 +410,27 @@ autospeak (AutospeakMode mode) {
             }
             if (newLength < newWidth) newLength += 1;
 
-            while (1) {
-              int done = 1;
-
-              if (x < newLength) {
-                if (isSameRow(newCharacters+x, oldCharacters+oldX, newWidth-x, isSameText)) {
-                  column = newX;
-                  count = prefs.autospeakInsertedCharacters? (x - newX): 0;
-                  reason = "characters inserted after cursor";
-                  goto autospeak;
-                }
-
-                done = 0;
+            {
+              int tail = newWidth - newX;
+              int inserted = findTextShift(oldCharacters+newX, newCharacters+newX, tail);
+              int deleted = findTextShift(newCharacters+newX, oldCharacters+newX, tail);
+              int haveInsertion = (newX + inserted) < newLength;
+              int haveDeletion = (newX + deleted) < oldLength;
+
+              if (haveInsertion && (!haveDeletion || (inserted <= deleted))) {
+                column = newX;
+                count = prefs.autospeakInsertedCharacters? inserted: 0;
+                reason = "characters inserted after cursor";
+                goto autospeak;
               }
 
-              if (x < oldLength) {
-                if (isSameRow(newCharacters+newX, oldCharacters+x, oldWidth-x, isSameText)) {
-                  characters = oldCharacters;
-                  column = oldX;
-                  count = prefs.autospeakDeletedCharacters? (x - oldX): 0;
-                  reason = "characters deleted after cursor";
-                  goto autospeak;
-                }
-
-                done = 0;
+              if (haveDeletion) {
+                characters = oldCharacters;
+                column = oldX;
+                count = prefs.autospeakDeletedCharacters? deleted: 0;
+                reason = "characters deleted after cursor";
+                goto autospeak;
               }
-
-              if (done) break;
-              x += 1;
             }
           }
 
@@ -579,6 +609,161 @@ writeBrailleWindow (BrailleDisplay *brl, const wchar_t *text) {
   return braille->writeWindow(brl, text);
 }
 
+#ifdef ENABLE_CONTRACTED_BRAILLE
+typedef enum {
+  CPS_NEXT_WINDOW,
+  CPS_PREVIOUS_WINDOW,
+  CPS_ROW_ABOVE,
+  CPS_ROW_BELOW,
+  CPS_DONE
+} ContractionPrefetchStep;
+
+static struct {
+  unsigned isScheduled:1;
+  ContractionPrefetchStep step;
+
+  int screen;
+  int column;
+  int row;
+  int cursor;
+  unsigned int outputLength;
+
+  struct {
+    wchar_t *characters;
+    unsigned int size;
+    unsigned int count;
+  } text;
+} contractionPrefetch = {
+  .step = CPS_DONE,
+  .screen = -1
+};
+
+static int
+testContractionPrefetch (const wchar_t *text, unsigned int count, unsigned int outputLength) {
+  if (contractionPrefetch.screen != scr.number) return 0;
+  if (contractionPrefetch.column != ses->winx) return 0;
+  if (contractionPrefetch.row != ses->winy) return 0;
+  if (contractionPrefetch.cursor != getContractedCursor()) return 0;
+  if (contractionPrefetch.outputLength != outputLength) return 0;
+  if (contractionPrefetch.text.count != count) return 0;
+  if (wmemcmp(contractionPrefetch.text.characters, text, count) != 0) return 0;
+  return 1;
+}
+
+static int
+isContractionPrefetchCurrent (void) {
+  if (!isContracting()) return 0;
+
+  {
+    int count = scr.cols - contractionPrefetch.column;
+
+    if (count < 1) return 0;
+
+    {
+      wchar_t text[count];
+
+      readScreenText(contractionPrefetch.column, contractionPrefetch.row, count, 1, text);
+      return testContractionPrefetch(text, count, contractionPrefetch.outputLength);
+    }
+  }
+}
+
+static void scheduleContractionPrefetchStep (void);
+
+ASYNC_TASK_CALLBACK(prefetchContractedWindows) {
+  contractionPrefetch.isScheduled = 0;
+  if (contractionPrefetch.step == CPS_DONE) return;
+
+  if (!isContractionPrefetchCurrent()) {
+    logMessage(LOG_CATEGORY(UPDATE_EVENTS), "contraction prefetch cancelled");
+    contractionPrefetch.step = CPS_DONE;
+    return;
+  }
+
+  {
+    const int column = contractionPrefetch.column;
+    const int row = contractionPrefetch.row;
+    const unsigned int outputLength = contractionPrefetch.outputLength;
+
+    /* an asynchronous (external) contraction can't yet tell where a window ends */
+    const int canFindWindows = !isAsynchronousContraction(contractionTable);
+
+    switch (contractionPrefetch.step++) {
+      case CPS_NEXT_WINDOW:
+        if (canFindWindows) {
+          int length = prefetchContractedLength(column, row, fullWindowShift);
+
+          if (length > 0) prefetchContractedLength(column+length, row, outputLength);
+        }
+        break;
+
+      case CPS_PREVIOUS_WINDOW:
+        if (canFindWindows && (column > 0)) {
+          int start = prefetchPreviousContractedWindow(column, row, fullWindowShift);
+
+          if (start >= 0) prefetchContractedLength(start, row, outputLength);
+        }
+        break;
+
+      case CPS_ROW_ABOVE:
+        prefetchContractedLength(column, row-1, outputLength);
+        break;
+
+      case CPS_ROW_BELOW:
+        prefetchContractedLength(column, row+1, outputLength);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  if (contractionPrefetch.step != CPS_DONE) scheduleContractionPrefetchStep();
+}
+
+static void
+scheduleContractionPrefetchStep (void) {
+  if (!contractionPrefetch.isScheduled) {
+    if (asyncAddTask(NULL, prefetchContractedWindows, NULL)) {
+      contractionPrefetch.isScheduled = 1;
+    } else {
+      contractionPrefetch.step = CPS_DONE;
+    }
+  }
+}
+
+static void
+scheduleContractionPrefetch (const wchar_t *text, unsigned int count, unsigned int outputLength) {
+  if (testContractionPrefetch(text, count, outputLength)) return;
+
+  if (count > contractionPrefetch.text.size) {
+    unsigned int newSize = count | 0XFF;
+    wchar_t *newCharacters = realloc(contractionPrefetch.text.characters, ARRAY_SIZE(newCharacters, newSize));
+
+    if (!newCharacters) {
+      logMallocError();
+      contractionPrefetch.step = CPS_DONE;
+      return;
+    }
+
+    contractionPrefetch.text.characters = newCharacters;
+    contractionPrefetch.text.size = newSize;
+  }
+
+  wmemcpy(contractionPrefetch.text.characters, text, count);
+  contractionPrefetch.text.count = count;
+
+  contractionPrefetch.screen = scr.number;
+  contractionPrefetch.column = ses->winx;
+  contractionPrefetch.row = ses->winy;
+  contractionPrefetch.cursor = getContractedCursor();
+  contractionPrefetch.outputLength = outputLength;
+
+  contractionPrefetch.step = CPS_NEXT_WINDOW;
+  scheduleContractionPrefetchStep();
+}
+#endif /* ENABLE_CONTRACTED_BRAILLE */
+
 static void
 doUpdate (void) {
   int screenPointerMoved = 0;
@@ -711,7 +896,8 @@ doUpdate (void) {
 
       if (isContracting()) {
         while (1) {
-          int inputLength = scr.cols - ses->winx;
+          const int rowLength = scr.cols - ses->winx;
+          int inputLength = rowLength;
           ScreenCharacter inputCharacters[inputLength];
           wchar_t inputText[inputLength];
 
@@ -732,10 +918,15 @@ doUpdate (void) {
                        outputBuffer, &outputLength,
                        contractedOffsets, getContractedCursor());
 
+          /* Cursor tracking waits for the real result of an asynchronous
+           * contraction so that the window isn't moved twice.
+           */
+          const int isProvisional = isContractionProvisional(contractionTable);
+
           {
             int inputEnd = inputLength;
 
-            if (contractedTrack) {
+            if (contractedTrack && !isProvisional) {
               if (outputLength == textLength) {
                 int inputIndex = inputEnd;
                 while (inputIndex) {
@@ -773,8 +964,9 @@ doUpdate (void) {
 
           contractedStart = ses->winx;
           contractedLength = inputLength;
-          contractedTrack = 0;
+          if (!isProvisional) contractedTrack = 0;
           isContracted = 1;
+          scheduleContractionPrefetch(inputText, rowLength, textLength);
 
           if (ses->displayMode || prefs.showAttributes) {
             int inputOffset;
@@ -866,12 +1058,16 @@ doUpdate (void) {
             wchar_t *text = &textBuffer[start];
             unsigned int column;
 
+            for (column=0; column<textCount; column+=1) {
+              text[column] = source[column].text;
+            }
+
+            convertCharactersToDots(textTable, text, target, textCount);
+
             for (column=0; column<textCount; column+=1) {
               const ScreenCharacter *character = &source[column];
               unsigned char *dots = &target[column];
 
-              *dots = convertCharacterToDots(textTable, character->text);
-
               if (iswupper(character->text)) {
                 BlinkDescriptor *blink = &uppercaseLettersBlinkDescriptor;
 
@@ -881,8 +1077,6 @@ doUpdate (void) {
 
               if (prefs.textStyle) *dots &= ~(BRL_DOT_7 | BRL_DOT_8);
               if (prefs.showAttributes) overlayAttributesUnderline(dots, character->attributes);
-
-              text[column] = character->text;
             }
           }
         }
@@ -0,0 +1,532 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2017 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU General Public License, as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-GPL for details.
+ *
+ * Web Page: http://brltty.com/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+/* Plays the part of the display for the Virtual braille driver, following
+ * a script, and writes a transcript of everything which the driver sends
+ * back. Each line of the script is one of these directives:
+ *
+ *   send text               write a command line (text mode)
+ *   frame type [byte ...]   write a frame (binary mode) - the length is added
+ *   bytes byte ...          write raw bytes
+ *   connect                 start the driver - what has been sent so far is
+ *                           written as soon as it connects
+ *   window [text]           write the braille window - each cell's dots are
+ *                           the low-order eight bits of its character
+ *   command                 read one command from the driver
+ *   disconnect              stop the driver
+ *
+ * Blank lines, and lines starting with #, are ignored. Each directive is
+ * copied to the transcript, followed by what the driver wrote in response.
+ * The driver's lines are prefixed with "<", and, once it has confirmed
+ * binary mode, each of its frames is shown as its type, its offset (where
+ * it has one), and its payload.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "program.h"
+#include "options.h"
+#include "log.h"
+#include "parse.h"
+#include "file.h"
+#include "charset.h"
+#include "async_alarm.h"
+#include "brl.h"
+
+BrailleDisplay brl;
+
+static char *opt_driversDirectory;
+
+BEGIN_OPTION_TABLE(programOptions)
+  { .letter = 'D',
+    .word = "drivers-directory",
+    .flags = OPT_Hidden,
+    .argument = "directory",
+    .setting.string = &opt_driversDirectory,
+    .internal.setting = DRIVERS_DIRECTORY,
+    .internal.adjust = fixInstallPath,
+    .description = "Path to directory for loading drivers."
+  },
+END_OPTION_TABLE
+
+typedef struct {
+  const char *scriptPath;
+  unsigned int lineNumber;
+  int ok;
+
+  struct sockaddr_un address;
+  int listeningSocket;
+  int displaySocket;
+
+  struct {
+    unsigned char buffer[0X400];
+    size_t length;
+  } pending;
+
+  struct {
+    unsigned char buffer[0X20000];
+    size_t length;
+    unsigned binaryMode:1;
+  } received;
+
+  void *driverObject;
+  unsigned connected:1;
+} ScriptData;
+
+static void
+scriptError (ScriptData *sd, const char *format, ...) {
+  char message[0X100];
+  va_list arguments;
+
+  va_start(arguments, format);
+  vsnprintf(message, sizeof(message), format, arguments);
+  va_end(arguments);
+
+  logMessage(LOG_ERR, "%s[%u]: %s", sd->scriptPath, sd->lineNumber, message);
+  sd->ok = 0;
+}
+
+static int
+writeDisplayBytes (ScriptData *sd, const unsigned char *bytes, size_t count) {
+  if (sd->displaySocket == -1) {
+    if (count > (sizeof(sd->pending.buffer) - sd->pending.length)) {
+      scriptError(sd, "too much to send before connecting");
+      return 0;
+    }
+
+    memcpy(&sd->pending.buffer[sd->pending.length], bytes, count);
+    sd->pending.length += count;
+    return 1;
+  }
+
+  while (count) {
+    ssize_t result = send(sd->displaySocket, bytes, count, 0);
+
+    if (result == -1) {
+      if (errno == EINTR) continue;
+      logSystemError("send");
+      sd->ok = 0;
+      return 0;
+    }
+
+    bytes += result;
+    count -= result;
+  }
+
+  return 1;
+}
+
+ASYNC_ALARM_CALLBACK(acceptDriverConnection) {
+  ScriptData *sd = parameters->data;
+
+  if ((sd->displaySocket = accept(sd->listeningSocket, NULL, NULL)) == -1) {
+    logSystemError("accept");
+    sd->ok = 0;
+  } else {
+    size_t count = sd->pending.length;
+
+    sd->pending.length = 0;
+    writeDisplayBytes(sd, sd->pending.buffer, count);
+  }
+}
+
+static void
+showFrame (unsigned char type, const unsigned char *payload, size_t length) {
+  printf("< %c", type);
+
+  switch (type) {
+    case 'B':
+    case 'S':
+    case 'V':
+      if (length >= 2) {
+        printf(" %u:", ((payload[0] << 8) | payload[1]));
+        payload += 2;
+        length -= 2;
+      }
+
+      if (type == 'V') {
+        printf(" \"%.*s\"", (int)length, payload);
+        length = 0;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  while (length--) printf(" %02X", *payload++);
+  printf("\n");
+}
+
+static void
+showReceivedData (ScriptData *sd) {
+  unsigned char *buffer = sd->received.buffer;
+  size_t length = sd->received.length;
+
+  while (length) {
+    if (sd->received.binaryMode) {
+      size_t size;
+
+      if (length < 3) break;
+      size = 3 + ((buffer[1] << 8) | buffer[2]);
+      if (length < size) break;
+
+      showFrame(buffer[0], &buffer[3], (size - 3));
+      buffer += size;
+      length -= size;
+    } else {
+      unsigned char *newline = memchr(buffer, '\n', length);
+      size_t count;
+
+      if (!newline) break;
+      count = newline - buffer;
+      if (count && (buffer[count-1] == '\r')) count -= 1;
+
+      printf("< %.*s\n", (int)count, buffer);
+      if ((count == 6) && (memcmp(buffer, "Binary", count) == 0)) sd->received.binaryMode = 1;
+
+      count = newline - buffer + 1;
+      buffer += count;
+      length -= count;
+    }
+  }
+
+  memmove(sd->received.buffer, buffer, length);
+  sd->received.length = length;
+}
+
+static void
+receiveDriverData (ScriptData *sd) {
+  if (sd->displaySocket != -1) {
+    while (1) {
+      size_t size = sizeof(sd->received.buffer) - sd->received.length;
+      ssize_t count;
+
+      if (!size) {
+        logMessage(LOG_ERR, "receive buffer full");
+        sd->ok = 0;
+        break;
+      }
+
+      count = recv(sd->displaySocket, &sd->received.buffer[sd->received.length], size, MSG_DONTWAIT);
+
+      if (count == -1) {
+        if (errno == EINTR) continue;
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) logSystemError("recv");
+        break;
+      }
+
+      if (!count) {
+        showReceivedData(sd);
+        if (sd->received.length) printf("< (%u bytes left over)\n", (unsigned int)sd->received.length);
+        printf("< (closed)\n");
+
+        close(sd->displaySocket);
+        sd->displaySocket = -1;
+        sd->received.length = 0;
+        sd->received.binaryMode = 0;
+        return;
+      }
+
+      sd->received.length += count;
+    }
+
+    showReceivedData(sd);
+  }
+}
+
+static int
+parseBytes (ScriptData *sd, unsigned char *bytes, size_t size, size_t *count) {
+  const char *word;
+
+  *count = 0;
+
+  while ((word = strtok(NULL, " \t"))) {
+    int value;
+
+    if (!isInteger(&value, word) || (value < 0) || (value > 0XFF)) {
+      scriptError(sd, "invalid byte: %s", word);
+      return 0;
+    }
+
+    if (*count == size) {
+      scriptError(sd, "too many bytes");
+      return 0;
+    }
+
+    bytes[(*count)++] = value;
+  }
+
+  return 1;
+}
+
+static void
+connectDriver (ScriptData *sd) {
+  static char *parameters[] = {NULL};
+  char device[sizeof(sd->address.sun_path) + 8];
+  AsyncHandle alarm;
+
+  snprintf(device, sizeof(device), "client:%s", sd->address.sun_path);
+  constructBrailleDisplay(&brl);
+
+  if (!asyncSetAlarmIn(&alarm, 0, acceptDriverConnection, sd)) {
+    sd->ok = 0;
+  } else if (!braille->construct(&brl, parameters, device)) {
+    scriptError(sd, "can't start the driver");
+  } else if (!ensureBrailleBuffer(&brl, LOG_DEBUG)) {
+    sd->ok = 0;
+    braille->destruct(&brl);
+  } else {
+    sd->connected = 1;
+    printf("= %dx%d\n", brl.textColumns, brl.textRows);
+  }
+}
+
+static void
+disconnectDriver (ScriptData *sd) {
+  if (sd->connected) {
+    braille->destruct(&brl);
+    destructBrailleDisplay(&brl);
+    sd->connected = 0;
+  }
+}
+
+static void
+writeWindow (ScriptData *sd, const char *text) {
+  unsigned int size = brl.textColumns * brl.textRows;
+  wchar_t characters[size + 1];
+  unsigned int index;
+
+  {
+    wchar_t *character = characters;
+    convertUtf8ToWchars(&text, &character, ARRAY_COUNT(characters));
+    index = character - characters;
+  }
+
+  while (index < size) characters[index++] = WC_C(' ');
+  for (index=0; index<size; index+=1) brl.buffer[index] = characters[index] & 0XFF;
+
+  if (!braille->writeWindow(&brl, characters)) {
+    scriptError(sd, "can't write the window");
+  }
+}
+
+static void
+readCommand (ScriptData *sd) {
+  int rows = brl.textRows;
+  int columns = brl.textColumns;
+  int command = readBrailleCommand(&brl, KTB_CTX_DEFAULT);
+
+  if (command == EOF) {
+    printf("= no command\n");
+  } else {
+    printf("= command %04X\n", command);
+  }
+
+  if ((brl.textRows != rows) || (brl.textColumns != columns)) {
+    printf("= %dx%d\n", brl.textColumns, brl.textRows);
+  }
+}
+
+static const char *
+getOperand (const char *directive, const char *end) {
+  const char *operand = directive + strlen(directive) + 1;
+
+  return (operand < end)? operand: end;
+}
+
+static int
+handleScriptLine (char *line, void *data) {
+  ScriptData *sd = data;
+  const char *directive;
+  const char *end;
+
+  sd->lineNumber += 1;
+
+  {
+    size_t length = strlen(line);
+
+    while (length && ((line[length-1] == '\n') || (line[length-1] == '\r'))) length -= 1;
+    line[length] = 0;
+    end = &line[length];
+  }
+
+  if (!*line || (*line == '#')) return 1;
+  printf("%s\n", line);
+
+  if (!(directive = strtok(line, " \t"))) return 1;
+
+  if (strcmp(directive, "send") == 0) {
+    const char *text = getOperand(directive, end);
+
+    writeDisplayBytes(sd, (const unsigned char *)text, strlen(text));
+    writeDisplayBytes(sd, (const unsigned char *)"\n", 1);
+  } else if (strcmp(directive, "frame") == 0) {
+    const char *type = strtok(NULL, " \t");
+
+    if (!type || (strlen(type) != 1)) {
+      scriptError(sd, "missing frame type");
+    } else {
+      unsigned char frame[0X103];
+      size_t count;
+
+      if (parseBytes(sd, &frame[3], (sizeof(frame) - 3), &count)) {
+        frame[0] = *type;
+        frame[1] = count >> 8;
+        frame[2] = count & 0XFF;
+        writeDisplayBytes(sd, frame, (count + 3));
+      }
+    }
+  } else if (strcmp(directive, "bytes") == 0) {
+    unsigned char bytes[0X100];
+    size_t count;
+
+    if (parseBytes(sd, bytes, sizeof(bytes), &count)) {
+      writeDisplayBytes(sd, bytes, count);
+    }
+  } else if (strcmp(directive, "connect") == 0) {
+    if (sd->connected) {
+      scriptError(sd, "already connected");
+    } else {
+      connectDriver(sd);
+    }
+  } else if (!sd->connected) {
+    scriptError(sd, "not connected");
+  } else if (strcmp(directive, "window") == 0) {
+    writeWindow(sd, getOperand(directive, end));
+  } else if (strcmp(directive, "command") == 0) {
+    readCommand(sd);
+  } else if (strcmp(directive, "disconnect") == 0) {
+    disconnectDriver(sd);
+  } else {
+    scriptError(sd, "unknown directive: %s", directive);
+  }
+
+  receiveDriverData(sd);
+  fflush(stdout);
+  return sd->ok;
+}
+
+int
+main (int argc, char *argv[]) {
+  ProgramExitStatus exitStatus = PROG_EXIT_FATAL;
+
+  {
+    static const OptionsDescriptor descriptor = {
+      OPTION_TABLE(programOptions),
+      .applicationName = "vrtest",
+      .argumentsSummary = "script"
+    };
+
+    PROCESS_OPTIONS(descriptor, argc, argv);
+  }
+
+  if (argc != 1) {
+    logMessage(LOG_ERR, "missing script");
+    return PROG_EXIT_SYNTAX;
+  }
+
+  {
+    ScriptData sd = {
+      .scriptPath = argv[0],
+      .ok = 1,
+      .listeningSocket = -1,
+      .displaySocket = -1
+    };
+
+    FILE *script;
+
+    if ((script = fopen(sd.scriptPath, "r"))) {
+      if ((braille = loadBrailleDriver("vr", &sd.driverObject, opt_driversDirectory))) {
+        {
+          const char *directory = getenv("TMPDIR");
+
+          if (!directory || !*directory) directory = "/tmp";
+          memset(&sd.address, 0, sizeof(sd.address));
+          sd.address.sun_family = AF_LOCAL;
+          snprintf(sd.address.sun_path, sizeof(sd.address.sun_path),
+                   "%s/vrtest.%d", directory, (int)getpid());
+        }
+
+        if ((sd.listeningSocket = socket(PF_LOCAL, SOCK_STREAM, 0)) == -1) {
+          logSystemError("socket");
+        } else {
+          unlink(sd.address.sun_path);
+
+          if (bind(sd.listeningSocket, (struct sockaddr *)&sd.address, sizeof(sd.address)) == -1) {
+            logSystemError("bind");
+          } else {
+            if (listen(sd.listeningSocket, 1) == -1) {
+              logSystemError("listen");
+            } else if (!processLines(script, handleScriptLine, &sd)) {
+              logMessage(LOG_ERR, "%s: %s", sd.scriptPath, strerror(errno));
+            } else if (sd.ok) {
+              exitStatus = PROG_EXIT_SUCCESS;
+            } else {
+              exitStatus = PROG_EXIT_SEMANTIC;
+            }
+
+            disconnectDriver(&sd);
+            receiveDriverData(&sd);
+            unlink(sd.address.sun_path);
+          }
+
+          close(sd.listeningSocket);
+        }
+
+        if (sd.displaySocket != -1) close(sd.displaySocket);
+      } else {
+        logMessage(LOG_ERR, "can't load braille driver");
+      }
+
+      fclose(script);
+    } else {
+      logMessage(LOG_ERR, "%s: %s", sd.scriptPath, strerror(errno));
+    }
+  }
+
+  return exitStatus;
+}
+
+#include "message.h"
+
+int
+message (const char *mode, const char *text, MessageOptions options) {
+  return 1;
+}
+
+#include "scr.h"
+
+KeyTableCommandContext
+getScreenCommandContext (void) {
+  return KTB_CTX_DEFAULT;
+}
+
+#include "alert.h"
+
+void
+alert (AlertIdentifier identifier) {
+}